@@ -0,0 +1,663 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+
+/**
+ * Google Benchmark suite of the core library: make bench, extra arguments
+ * in BENCH_ARGS, e.g. BENCH_ARGS=--benchmark_filter=TestZones.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "nvdspostprocess_affinity.h"
+#include "nvdspostprocess_analytics.h"
+#include "nvdspostprocess_arena.h"
+#include "nvdspostprocess_overlay.h"
+#include "nvdspostprocess_stats.h"
+#include "nvdspostprocess_text.h"
+#include "nvdspostprocess_tiler.h"
+
+/* 1080p frame */
+#define BENCH_FRAME_WIDTH 1920
+#define BENCH_FRAME_HEIGHT 1080
+
+/* Objects of a frame as the element gathers them, boxes spread over the
+ * frame with a fixed seed. */
+typedef struct
+{
+  std::vector<float> left, top, width, height;
+  std::vector<uint64_t> object_id;
+  std::vector<uint8_t> counted;
+  std::vector<uint64_t> zone_mask;
+  AnalyticsObjects objects;
+} BenchObjects;
+
+static void
+bench_objects_init (BenchObjects *b, size_t n)
+{
+  std::mt19937 rng (1);
+  std::uniform_real_distribution<float> x (0, BENCH_FRAME_WIDTH - 200);
+  std::uniform_real_distribution<float> y (0, BENCH_FRAME_HEIGHT - 200);
+  std::uniform_real_distribution<float> size (20, 200);
+
+  b->left.resize (n);
+  b->top.resize (n);
+  b->width.resize (n);
+  b->height.resize (n);
+  b->object_id.resize (n);
+  b->counted.assign (n, 1);
+  b->zone_mask.assign (n, 0);
+  for (size_t i = 0; i < n; i++) {
+    b->left[i] = x (rng);
+    b->top[i] = y (rng);
+    b->width[i] = size (rng);
+    b->height[i] = size (rng);
+    b->object_id[i] = i;
+  }
+  b->objects = {b->left.data (), b->top.data (), b->width.data (),
+      b->height.data (), b->object_id.data (), b->counted.data (),
+      b->zone_mask.data ()};
+}
+
+/* Three zones of a 1080p camera, one of them concave. */
+static std::vector<AnalyticsZone>
+bench_zones (void)
+{
+  return {
+    {{100, 100}, {900, 120}, {1000, 600}, {500, 900}, {80, 700}},
+    {{1000, 100}, {1800, 100}, {1800, 1000}, {1000, 1000}},
+    {{200, 600}, {700, 500}, {900, 1000}, {300, 1050}, {150, 900},
+        {180, 750}}};
+}
+
+static void
+BM_TestZones (benchmark::State &state)
+{
+  size_t n = state.range (0);
+  BenchObjects b;
+  AnalyticsZoneSet zones = {};
+  AnalyticsSource src = {};
+
+  bench_objects_init (&b, n);
+  analytics_zone_set_init (&zones, bench_zones ());
+  analytics_source_init (&src, &zones);
+  for (auto _ : state)
+    benchmark::DoNotOptimize (analytics_test_zones (&src, &b.objects, n));
+  state.SetItemsProcessed (state.iterations () * n);
+}
+BENCHMARK (BM_TestZones)->Arg (100)->Arg (1000)->Arg (5000);
+
+/* Zone test of 5000 objects with every zone using the same anchor mode,
+ * half of the box area for the overlap. */
+static void
+BM_AnchorMode (benchmark::State &state)
+{
+  static const char *const names[] = {"bottom-centre", "centroid", "overlap"};
+  AnalyticsAnchorMode mode = (AnalyticsAnchorMode) state.range (0);
+  size_t n = 5000, num_zones;
+  BenchObjects b;
+  AnalyticsZoneSet zones = {};
+  AnalyticsSource src = {};
+
+  bench_objects_init (&b, n);
+  num_zones = analytics_zone_set_init (&zones, bench_zones ());
+  for (size_t z = 0; z < num_zones; z++)
+    analytics_zone_set_anchor (&zones, z, {mode, 0.5});
+  analytics_source_init (&src, &zones);
+  for (auto _ : state)
+    benchmark::DoNotOptimize (analytics_test_zones (&src, &b.objects, n));
+  state.SetItemsProcessed (state.iterations () * n);
+  state.SetLabel (names[mode]);
+}
+BENCHMARK (BM_AnchorMode)->DenseRange (ANALYTICS_ANCHOR_BOTTOM_CENTRE,
+    ANALYTICS_ANCHOR_OVERLAP);
+
+/* Zone test with the coverage of every zone measured (1) or not (0), the
+ * difference is the coverage cost at this object count. */
+static void
+BM_Coverage (benchmark::State &state)
+{
+  size_t n = state.range (0), num_zones;
+  BenchObjects b;
+  AnalyticsZoneSet zones = {};
+  AnalyticsSource src = {};
+
+  bench_objects_init (&b, n);
+  num_zones = analytics_zone_set_init (&zones, bench_zones ());
+  for (size_t z = 0; z < num_zones; z++)
+    analytics_zone_set_coverage (&zones, z, state.range (1));
+  analytics_source_init (&src, &zones);
+  for (auto _ : state)
+    benchmark::DoNotOptimize (analytics_test_zones (&src, &b.objects, n));
+  state.SetItemsProcessed (state.iterations () * n);
+}
+BENCHMARK (BM_Coverage)->ArgsProduct ({{100, 1000, 5000}, {0, 1}});
+
+/* Object metadata as a batch hands it over: a list of separately allocated
+ * structs, about the size of NvDsObjectMeta, linked in a shuffled order. */
+typedef struct _BenchObjectMeta
+{
+  struct _BenchObjectMeta *next;
+  float left, top, width, height;
+  int class_id;
+  uint64_t object_id;
+  float confidence;
+  uint8_t other_fields[448];
+} BenchObjectMeta;
+
+typedef struct
+{
+  std::vector<std::unique_ptr<BenchObjectMeta>> metas;
+  BenchObjectMeta *head;
+} BenchObjectList;
+
+static void
+bench_object_list_init (BenchObjectList *list, size_t n)
+{
+  BenchObjects b;
+  std::vector<BenchObjectMeta *> order;
+
+  bench_objects_init (&b, n);
+  for (size_t i = 0; i < n; i++) {
+    list->metas.emplace_back (new BenchObjectMeta ());
+    *list->metas.back () = {NULL, b.left[i], b.top[i], b.width[i],
+        b.height[i], (int) (i % 4), b.object_id[i], 0.5f, {}};
+    order.push_back (list->metas.back ().get ());
+  }
+  std::shuffle (order.begin (), order.end (), std::mt19937 (2));
+  list->head = NULL;
+  for (BenchObjectMeta *meta : order) {
+    meta->next = list->head;
+    list->head = meta;
+  }
+}
+
+/* Gather of a batch into columns of the scratch arena, as the element does:
+ * the list is counted first, then walked again to fill the columns. */
+static void
+BM_GatherArena (benchmark::State &state)
+{
+  size_t n = state.range (0);
+  const std::vector<int> classes = {0, 2};
+  BenchObjectList list;
+  ScratchArena arena = {};
+
+  bench_object_list_init (&list, n);
+  arena_init (&arena, ARENA_MIN_SIZE);
+  for (auto _ : state) {
+    size_t count = 0, i = 0;
+
+    for (BenchObjectMeta *meta = list.head; meta; meta = meta->next)
+      count++;
+    float *left = arena_alloc_array<float> (&arena, count);
+    float *top = arena_alloc_array<float> (&arena, count);
+    float *width = arena_alloc_array<float> (&arena, count);
+    float *height = arena_alloc_array<float> (&arena, count);
+    int *class_id = arena_alloc_array<int> (&arena, count);
+    uint64_t *object_id = arena_alloc_array<uint64_t> (&arena, count);
+    uint8_t *counted = arena_alloc_array<uint8_t> (&arena, count);
+    for (BenchObjectMeta *meta = list.head; meta; meta = meta->next, i++) {
+      left[i] = meta->left;
+      top[i] = meta->top;
+      width[i] = meta->width;
+      height[i] = meta->height;
+      class_id[i] = meta->class_id;
+      object_id[i] = meta->object_id;
+    }
+    for (i = 0; i < count; i++)
+      counted[i] = analytics_is_counted_class (classes, class_id[i]);
+    benchmark::DoNotOptimize (counted);
+    benchmark::ClobberMemory ();
+    arena_reset (&arena);
+  }
+  arena_free (&arena);
+  state.SetItemsProcessed (state.iterations () * n);
+}
+BENCHMARK (BM_GatherArena)->Arg (5000);
+
+/* Same gather into vectors created for the batch, the allocations the arena
+ * saves. */
+static void
+BM_GatherVectors (benchmark::State &state)
+{
+  size_t n = state.range (0);
+  const std::vector<int> classes = {0, 2};
+  BenchObjectList list;
+
+  bench_object_list_init (&list, n);
+  for (auto _ : state) {
+    size_t count = 0, i = 0;
+
+    for (BenchObjectMeta *meta = list.head; meta; meta = meta->next)
+      count++;
+    std::vector<float> left (count), top (count), width (count),
+        height (count);
+    std::vector<int> class_id (count);
+    std::vector<uint64_t> object_id (count);
+    std::vector<uint8_t> counted (count);
+    for (BenchObjectMeta *meta = list.head; meta; meta = meta->next, i++) {
+      left[i] = meta->left;
+      top[i] = meta->top;
+      width[i] = meta->width;
+      height[i] = meta->height;
+      class_id[i] = meta->class_id;
+      object_id[i] = meta->object_id;
+    }
+    for (i = 0; i < count; i++)
+      counted[i] = analytics_is_counted_class (classes, class_id[i]);
+    benchmark::DoNotOptimize (counted.data ());
+    benchmark::ClobberMemory ();
+  }
+  state.SetItemsProcessed (state.iterations () * n);
+}
+BENCHMARK (BM_GatherVectors)->Arg (5000);
+
+/* Objects per frame of the pipelined benchmark. */
+#define BENCH_PIPELINE_OBJECTS 200
+
+/* Batch slot of the pipelined benchmark, as GstNvDsPostProcessBatch: the
+ * columns of all the frames of a batch in its arena. */
+typedef struct
+{
+  ScratchArena arena;
+  float *left, *top, *width, *height;
+  uint64_t *object_id;
+  uint8_t *counted;
+  uint64_t *zone_mask;
+  /** first object of every frame */
+  size_t *first;
+  size_t num_objects;
+  /** handed to the output thread and not counted yet */
+  bool in_flight;
+} BenchBatch;
+
+/* Sources of the pipelined benchmark, every batch has one frame of each. */
+typedef struct
+{
+  std::vector<BenchObjectList> frames;
+  AnalyticsZoneSet zones;
+  std::vector<AnalyticsSource> sources;
+} BenchStream;
+
+static void
+bench_stream_init (BenchStream *stream, size_t num_sources)
+{
+  stream->frames.resize (num_sources);
+  for (BenchObjectList &frame : stream->frames)
+    bench_object_list_init (&frame, BENCH_PIPELINE_OBJECTS);
+  stream->zones = {};
+  analytics_zone_set_init (&stream->zones, bench_zones ());
+  stream->sources.resize (num_sources);
+  for (AnalyticsSource &src : stream->sources)
+    analytics_source_init (&src, &stream->zones);
+}
+
+/* Streaming thread part of a batch: walk the metadata into the columns. */
+static void
+bench_batch_gather (BenchBatch *batch, const BenchStream *stream)
+{
+  const std::vector<int> classes = {0, 2};
+  size_t count = 0, i = 0;
+
+  for (const BenchObjectList &frame : stream->frames) {
+    for (BenchObjectMeta *meta = frame.head; meta; meta = meta->next)
+      count++;
+  }
+  batch->left = arena_alloc_array<float> (&batch->arena, count);
+  batch->top = arena_alloc_array<float> (&batch->arena, count);
+  batch->width = arena_alloc_array<float> (&batch->arena, count);
+  batch->height = arena_alloc_array<float> (&batch->arena, count);
+  batch->object_id = arena_alloc_array<uint64_t> (&batch->arena, count);
+  batch->counted = arena_alloc_array<uint8_t> (&batch->arena, count);
+  batch->zone_mask = arena_alloc_array<uint64_t> (&batch->arena, count);
+  batch->first = arena_alloc_array<size_t> (&batch->arena,
+      stream->frames.size () + 1);
+  for (size_t f = 0; f < stream->frames.size (); f++) {
+    batch->first[f] = i;
+    for (BenchObjectMeta *meta = stream->frames[f].head; meta;
+        meta = meta->next, i++) {
+      batch->left[i] = meta->left;
+      batch->top[i] = meta->top;
+      batch->width[i] = meta->width;
+      batch->height[i] = meta->height;
+      batch->object_id[i] = meta->object_id;
+      batch->counted[i] = analytics_is_counted_class (classes, meta->class_id);
+    }
+  }
+  batch->first[stream->frames.size ()] = i;
+  batch->num_objects = i;
+}
+
+/* Output thread part of a batch: zone test and track update of every
+ * frame, then the scratch is released. */
+static void
+bench_batch_count (BenchBatch *batch, BenchStream *stream)
+{
+  AnalyticsObjects objects = {batch->left, batch->top, batch->width,
+      batch->height, batch->object_id, batch->counted, batch->zone_mask};
+
+  for (size_t f = 0; f < stream->sources.size (); f++) {
+    AnalyticsObjects frame = analytics_objects_slice (objects, batch->first[f]);
+    AnalyticsFrameResult result;
+
+    analytics_process_frame (&stream->sources[f], &frame,
+        batch->first[f + 1] - batch->first[f], &result);
+    benchmark::DoNotOptimize (result);
+  }
+  arena_reset (&batch->arena);
+}
+
+/* Batches of 200 objects per source, gathered and counted on one thread
+ * (0) or pipelined as async=1 does (1): the caller gathers the next batch
+ * into the free slot while a second thread counts the previous one. The
+ * gain needs a second core, on a single CPU the threads only take turns. */
+static void
+BM_Pipeline (benchmark::State &state)
+{
+  size_t num_sources = state.range (0);
+  bool pipelined = state.range (1);
+  BenchStream stream;
+  BenchBatch batches[2] = {};
+  std::mutex lock;
+  std::condition_variable cond;
+  std::thread output;
+  size_t gather_batch = 0;
+  bool stop = false;
+
+  bench_stream_init (&stream, num_sources);
+  for (BenchBatch &batch : batches)
+    arena_init (&batch.arena, ARENA_MIN_SIZE);
+
+  if (pipelined) {
+    output = std::thread ([&] {
+      std::unique_lock<std::mutex> guard (lock);
+      size_t output_batch = 0;
+
+      while (true) {
+        BenchBatch *batch = &batches[output_batch];
+
+        cond.wait (guard, [&] { return batch->in_flight || stop; });
+        if (!batch->in_flight)
+          break;
+        guard.unlock ();
+        bench_batch_count (batch, &stream);
+        guard.lock ();
+        batch->in_flight = false;
+        output_batch = (output_batch + 1) % 2;
+        cond.notify_all ();
+      }
+    });
+  }
+
+  for (auto _ : state) {
+    BenchBatch *batch = &batches[gather_batch];
+
+    if (!pipelined) {
+      bench_batch_gather (batch, &stream);
+      bench_batch_count (batch, &stream);
+      continue;
+    }
+    {
+      std::unique_lock<std::mutex> guard (lock);
+      cond.wait (guard, [&] { return !batch->in_flight; });
+    }
+    bench_batch_gather (batch, &stream);
+    std::lock_guard<std::mutex> guard (lock);
+    batch->in_flight = true;
+    gather_batch = (gather_batch + 1) % 2;
+    cond.notify_all ();
+  }
+
+  if (pipelined) {
+    {
+      std::lock_guard<std::mutex> guard (lock);
+      stop = true;
+      cond.notify_all ();
+    }
+    output.join ();
+  }
+  for (BenchBatch &batch : batches)
+    arena_free (&batch.arena);
+  state.SetItemsProcessed (state.iterations () * num_sources *
+      BENCH_PIPELINE_OBJECTS);
+  state.counters["batches"] = benchmark::Counter (state.iterations (),
+      benchmark::Counter::kIsRate);
+}
+BENCHMARK (BM_Pipeline)->ArgsProduct ({{8, 32}, {0, 1}})->UseRealTime ();
+
+/* Tracks of the cross node benchmark, a table of 512k slots, well past the
+ * caches. */
+#define BENCH_NUMA_TRACKS (200 * 1000)
+
+/* Frames of a source counted on the first NUMA node while its state was
+ * allocated and first touched by a thread of the first node (0) or of the
+ * second one (1), i.e. the traffic an unpinned owner thread can cause. */
+static void
+BM_CrossNode (benchmark::State &state)
+{
+  bool remote = state.range (0);
+  std::vector<int> cpus;
+  std::vector<std::vector<int>> nodes;
+  std::vector<BenchObjects> frames (16);
+  AnalyticsZoneSet zones = {};
+  AnalyticsSource src = {};
+  std::mt19937 rng (3);
+  size_t f = 0;
+
+  for (long cpu = 0; cpu < sysconf (_SC_NPROCESSORS_ONLN); cpu++)
+    cpus.push_back (cpu);
+  nodes = affinity_split_by_node (cpus);
+  if (nodes.size () < 2) {
+    state.SkipWithError ("needs two NUMA nodes");
+    return;
+  }
+
+  analytics_zone_set_init (&zones, bench_zones ());
+  for (BenchObjects &b : frames) {
+    bench_objects_init (&b, 5000);
+    for (uint64_t &id : b.object_id)
+      id = rng () % BENCH_NUMA_TRACKS;
+  }
+
+  affinity_pin_current_thread (nodes[0]);
+  std::thread owner ([&] {
+    BenchObjects b;
+    AnalyticsFrameResult result;
+
+    affinity_pin_current_thread (nodes[remote ? 1 : 0]);
+    analytics_source_init (&src, &zones);
+    bench_objects_init (&b, 5000);
+    for (uint64_t first = 0; first < BENCH_NUMA_TRACKS; first += 5000) {
+      for (size_t i = 0; i < 5000; i++)
+        b.object_id[i] = first + i;
+      analytics_process_frame (&src, &b.objects, 5000, &result);
+    }
+  });
+  owner.join ();
+
+  for (auto _ : state) {
+    AnalyticsFrameResult result;
+
+    analytics_process_frame (&src, &frames[f].objects, 5000, &result);
+    benchmark::DoNotOptimize (result);
+    f = (f + 1) % frames.size ();
+  }
+  state.SetItemsProcessed (state.iterations () * 5000);
+  affinity_pin_current_thread (cpus);
+}
+BENCHMARK (BM_CrossNode)->Arg (0)->Arg (1);
+
+static void
+BM_OverlayBoxes (benchmark::State &state)
+{
+  size_t n = state.range (0);
+  std::vector<uint8_t> frame (BENCH_FRAME_WIDTH * BENCH_FRAME_HEIGHT * 4);
+  OverlaySurface surf = {};
+  BenchObjects b;
+
+  bench_objects_init (&b, n);
+  for (auto _ : state) {
+    overlay_begin_frame (&surf, frame.data (), BENCH_FRAME_WIDTH,
+        BENCH_FRAME_HEIGHT, BENCH_FRAME_WIDTH * 4);
+    for (size_t i = 0; i < n; i++) {
+      OverlayRect rect = {(int32_t) b.left[i], (int32_t) b.top[i],
+          (int32_t) (b.left[i] + b.width[i]),
+          (int32_t) (b.top[i] + b.height[i])};
+      overlay_draw_rect (&surf, rect, 2, {255, 0, 0, 255});
+    }
+    benchmark::ClobberMemory ();
+  }
+  state.SetItemsProcessed (state.iterations () * n);
+}
+BENCHMARK (BM_OverlayBoxes)->Arg (200);
+
+/* Whole overlay of a 1080p frame as the element draws it with its default
+ * properties: filled and outlined zones, a count label per zone whose text
+ * changes every frame, then the boxes. */
+static void
+BM_OverlayFrame (benchmark::State &state)
+{
+  size_t n = state.range (0);
+  std::vector<uint8_t> frame (BENCH_FRAME_WIDTH * BENCH_FRAME_HEIGHT * 4);
+  std::vector<AnalyticsZone> zones = bench_zones ();
+  std::vector<OverlayPolygon> polys (zones.size ());
+  std::vector<TextLabel> labels (zones.size ());
+  OverlaySurface surf = {};
+  OverlayScratch scratch;
+  TextAtlas atlas;
+  BenchObjects b;
+  uint64_t frame_num = 0;
+
+  for (size_t z = 0; z < zones.size (); z++) {
+    for (const AnalyticsPoint &pt : zones[z])
+      polys[z].pts.push_back ({(int32_t) pt.x, (int32_t) pt.y});
+    polys[z].border = {255, 255, 0, 255};
+    overlay_compile_polygon (&polys[z]);
+  }
+  text_atlas_init (&atlas, 2);
+  bench_objects_init (&b, n);
+  for (auto _ : state) {
+    overlay_begin_frame (&surf, frame.data (), BENCH_FRAME_WIDTH,
+        BENCH_FRAME_HEIGHT, BENCH_FRAME_WIDTH * 4);
+    for (size_t z = 0; z < polys.size (); z++) {
+      char text[32];
+
+      overlay_fill_polygon (&surf, &polys[z], {255, 255, 0, 76}, &scratch);
+      overlay_draw_polygon (&surf, &polys[z], 2);
+      snprintf (text, sizeof (text), "Zone %zu: %lu", z,
+          (unsigned long) (frame_num % 100));
+      text_label_set (&labels[z], &atlas, text);
+      text_label_draw (&surf, &labels[z], &atlas, polys[z].bounds.left,
+          polys[z].bounds.top + 4, {255, 255, 255, 255}, {0, 0, 0, 160});
+    }
+    for (size_t i = 0; i < n; i++) {
+      OverlayRect rect = {(int32_t) b.left[i], (int32_t) b.top[i],
+          (int32_t) (b.left[i] + b.width[i]),
+          (int32_t) (b.top[i] + b.height[i])};
+      overlay_draw_rect (&surf, rect, 2, {0, 255, 0, 255});
+    }
+    benchmark::ClobberMemory ();
+    frame_num++;
+  }
+  state.counters["fps"] = benchmark::Counter (state.iterations (),
+      benchmark::Counter::kIsRate);
+}
+BENCHMARK (BM_OverlayFrame)->Arg (50)->Arg (200);
+
+static void
+BM_TilerScale (benchmark::State &state)
+{
+  uint32_t dst_width = BENCH_FRAME_WIDTH / state.range (0);
+  uint32_t dst_height = BENCH_FRAME_HEIGHT / state.range (0);
+  std::vector<uint8_t> src (BENCH_FRAME_WIDTH * BENCH_FRAME_HEIGHT * 4, 128);
+  std::vector<uint8_t> dst (dst_width * dst_height * 4);
+  TilerScaler scaler = {};
+
+  for (auto _ : state) {
+    tiler_scale_rgba (&scaler, src.data (), BENCH_FRAME_WIDTH,
+        BENCH_FRAME_HEIGHT, BENCH_FRAME_WIDTH * 4, dst.data (), dst_width,
+        dst_height, dst_width * 4);
+    benchmark::ClobberMemory ();
+  }
+  state.SetBytesProcessed (state.iterations () * src.size ());
+}
+BENCHMARK (BM_TilerScale)->Arg (4)->Arg (6);
+
+/* Mosaic of a whole batch: every 1080p source scaled into its tile of a 1080p
+ * output, as the element does when all the tiles changed. The sources cycle
+ * over 4 frames, already more than the caches hold. */
+static void
+BM_TilerCompose (benchmark::State &state)
+{
+  uint32_t grid = state.range (0);
+  uint32_t ntiles = grid * grid;
+  uint32_t tile_width = BENCH_FRAME_WIDTH / grid;
+  uint32_t tile_height = BENCH_FRAME_HEIGHT / grid;
+  uint32_t pitch = BENCH_FRAME_WIDTH * 4;
+  std::vector<std::vector<uint8_t>> src (4);
+  std::vector<uint8_t> dst (BENCH_FRAME_HEIGHT * pitch);
+  std::vector<TilerScaler> scalers (ntiles);
+
+  for (size_t i = 0; i < src.size (); i++)
+    src[i].assign (BENCH_FRAME_HEIGHT * pitch, 64 * i);
+  for (auto _ : state) {
+    for (uint32_t tile = 0; tile < ntiles; tile++)
+      tiler_scale_rgba (&scalers[tile], src[tile % src.size ()].data (),
+          BENCH_FRAME_WIDTH, BENCH_FRAME_HEIGHT, pitch,
+          dst.data () + (size_t) (tile / grid) * tile_height * pitch +
+          (size_t) (tile % grid) * tile_width * 4, tile_width, tile_height,
+          pitch);
+    benchmark::ClobberMemory ();
+  }
+  state.SetBytesProcessed (state.iterations () * ntiles * src[0].size ());
+  state.counters["fps"] = benchmark::Counter (state.iterations (),
+      benchmark::Counter::kIsRate);
+}
+BENCHMARK (BM_TilerCompose)->Arg (4)->Arg (6);
+
+static void
+BM_HistogramRecord (benchmark::State &state)
+{
+  static LatencyHistogram hist;
+  uint64_t ns = 1000;
+
+  latency_histogram_reset (&hist);
+  for (auto _ : state) {
+    latency_histogram_record (&hist, ns);
+    ns = ns * 6364136223846793005ull + 1442695040888963407ull;
+    ns = (ns >> 40) + 1;
+  }
+  state.SetItemsProcessed (state.iterations ());
+}
+BENCHMARK (BM_HistogramRecord);
+
+BENCHMARK_MAIN ();
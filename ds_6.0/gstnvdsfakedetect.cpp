@@ -0,0 +1,878 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <errno.h>
+#include <string.h>
+#include <cmath>
+#include <algorithm>
+#include "gstnvdsfakedetect.h"
+#include "gstnvdsbufferpool.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_nvdsfakedetect_debug);
+#define GST_CAT_DEFAULT gst_nvdsfakedetect_debug
+
+/* Enum to identify properties */
+enum
+{
+  PROP_0,
+  PROP_NUM_SOURCES,
+  PROP_WIDTH,
+  PROP_HEIGHT,
+  PROP_FPS,
+  PROP_IS_LIVE,
+  PROP_OBJECTS_PER_FRAME,
+  PROP_OBJECT_LIFETIME,
+  PROP_MOTION,
+  PROP_SPEED,
+  PROP_CLASS_MIX,
+  PROP_SEED,
+  PROP_REPLAY_FILE
+};
+
+/* Default values for properties */
+#define DEFAULT_NUM_SOURCES 4
+#define DEFAULT_WIDTH 1280
+#define DEFAULT_HEIGHT 720
+#define DEFAULT_FPS 30
+#define DEFAULT_IS_LIVE FALSE
+#define DEFAULT_OBJECTS_PER_FRAME 20
+#define DEFAULT_OBJECT_LIFETIME 300
+#define DEFAULT_MOTION NVDSFAKEDETECT_MOTION_LINEAR
+#define DEFAULT_SPEED 4.0
+#define DEFAULT_CLASS_MIX "0"
+#define DEFAULT_SEED 0
+#define DEFAULT_REPLAY_FILE ""
+#define DEFAULT_BUF_POOL_SIZE 4 /** Batched Surface Pool Size */
+
+/** unique_component_id of the generated objects, as a primary detector */
+#define FAKEDETECT_COMPONENT_ID 1
+
+/** sources a batch may hold, same bound as the source counters */
+#define FAKEDETECT_MAX_SOURCES 1024
+
+/** box width range as a fraction of the frame width, height is 1x-2.5x it */
+#define FAKEDETECT_MIN_BOX_FRACTION 0.04
+#define FAKEDETECT_MAX_BOX_FRACTION 0.12
+
+#define GST_CAPS_FEATURE_MEMORY_NVMM "memory:NVMM"
+static GstStaticPadTemplate gst_nvdsfakedetect_src_template =
+GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE_WITH_FEATURES
+        (GST_CAPS_FEATURE_MEMORY_NVMM,
+            "{ RGBA }")));
+
+#define GST_TYPE_NVDSFAKEDETECT_MOTION (gst_nvdsfakedetect_motion_get_type ())
+static GType
+gst_nvdsfakedetect_motion_get_type (void)
+{
+  static GType motion_type = 0;
+  static const GEnumValue motion_values[] = {
+    {NVDSFAKEDETECT_MOTION_STATIC, "Boxes do not move", "static"},
+    {NVDSFAKEDETECT_MOTION_LINEAR,
+        "Constant velocity, bouncing on the frame borders", "linear"},
+    {NVDSFAKEDETECT_MOTION_RANDOM_WALK,
+        "Velocity perturbed every frame", "random-walk"},
+    {0, NULL, NULL}
+  };
+
+  if (!motion_type)
+    motion_type =
+        g_enum_register_static ("GstNvDsFakeDetectMotion", motion_values);
+  return motion_type;
+}
+
+/* Define our element type. Standard GObject/GStreamer boilerplate stuff */
+#define gst_nvdsfakedetect_parent_class parent_class
+G_DEFINE_TYPE_WITH_CODE (GstNvDsFakeDetect, gst_nvdsfakedetect,
+    GST_TYPE_BASE_SRC,
+    GST_DEBUG_CATEGORY_INIT (gst_nvdsfakedetect_debug, "nvdsfakedetect", 0,
+        "synthetic detection source"));
+
+static void gst_nvdsfakedetect_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_nvdsfakedetect_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+static void gst_nvdsfakedetect_finalize (GObject * object);
+
+static GstCaps *gst_nvdsfakedetect_get_caps (GstBaseSrc * bsrc,
+    GstCaps * filter);
+static gboolean gst_nvdsfakedetect_decide_allocation (GstBaseSrc * bsrc,
+    GstQuery * query);
+static gboolean gst_nvdsfakedetect_start (GstBaseSrc * bsrc);
+static gboolean gst_nvdsfakedetect_stop (GstBaseSrc * bsrc);
+static GstFlowReturn gst_nvdsfakedetect_fill (GstBaseSrc * bsrc,
+    guint64 offset, guint size, GstBuffer * buf);
+
+/* Install properties, set src pad capabilities, override the required
+ * functions of the base class.
+ */
+static void
+gst_nvdsfakedetect_class_init (GstNvDsFakeDetectClass * klass)
+{
+  GObjectClass *gobject_class;
+  GstElementClass *gstelement_class;
+  GstBaseSrcClass *gstbasesrc_class;
+
+  gobject_class = (GObjectClass *) klass;
+  gstelement_class = (GstElementClass *) klass;
+  gstbasesrc_class = (GstBaseSrcClass *) klass;
+
+  /* Overide base class functions */
+  gobject_class->set_property = GST_DEBUG_FUNCPTR (gst_nvdsfakedetect_set_property);
+  gobject_class->get_property = GST_DEBUG_FUNCPTR (gst_nvdsfakedetect_get_property);
+  gobject_class->finalize = GST_DEBUG_FUNCPTR (gst_nvdsfakedetect_finalize);
+
+  gstbasesrc_class->get_caps = GST_DEBUG_FUNCPTR (gst_nvdsfakedetect_get_caps);
+  gstbasesrc_class->decide_allocation =
+      GST_DEBUG_FUNCPTR (gst_nvdsfakedetect_decide_allocation);
+  gstbasesrc_class->start = GST_DEBUG_FUNCPTR (gst_nvdsfakedetect_start);
+  gstbasesrc_class->stop = GST_DEBUG_FUNCPTR (gst_nvdsfakedetect_stop);
+  gstbasesrc_class->fill = GST_DEBUG_FUNCPTR (gst_nvdsfakedetect_fill);
+
+  /* Install properties */
+  g_object_class_install_property (gobject_class, PROP_NUM_SOURCES,
+      g_param_spec_uint ("num-sources", "Number of sources",
+          "Frames per batch, source ids go from 0 to num-sources - 1",
+          1, FAKEDETECT_MAX_SOURCES, DEFAULT_NUM_SOURCES,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+
+  g_object_class_install_property (gobject_class, PROP_WIDTH,
+      g_param_spec_uint ("width", "Width",
+          "Width of the RGBA surfaces", 16, 8192, DEFAULT_WIDTH,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+
+  g_object_class_install_property (gobject_class, PROP_HEIGHT,
+      g_param_spec_uint ("height", "Height",
+          "Height of the RGBA surfaces", 16, 8192, DEFAULT_HEIGHT,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+
+  g_object_class_install_property (gobject_class, PROP_FPS,
+      g_param_spec_uint ("fps", "Frame rate",
+          "Frame rate of the buffer timestamps and caps",
+          1, 1000, DEFAULT_FPS,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+
+  g_object_class_install_property (gobject_class, PROP_IS_LIVE,
+      g_param_spec_boolean ("is-live", "Is live",
+          "Pace the batches at fps on the pipeline clock, otherwise they are "
+          "produced as fast as downstream consumes them",
+          DEFAULT_IS_LIVE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+
+  g_object_class_install_property (gobject_class, PROP_OBJECTS_PER_FRAME,
+      g_param_spec_uint ("objects-per-frame", "Objects per frame",
+          "Object meta attached to every frame",
+          0, 65536, DEFAULT_OBJECTS_PER_FRAME,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+
+  g_object_class_install_property (gobject_class, PROP_OBJECT_LIFETIME,
+      g_param_spec_uint ("object-lifetime", "Object lifetime",
+          "Mean number of frames a track lives before it is replaced by a "
+          "new object id, 0 keeps the tracks forever",
+          0, G_MAXUINT / 2, DEFAULT_OBJECT_LIFETIME,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+
+  g_object_class_install_property (gobject_class, PROP_MOTION,
+      g_param_spec_enum ("motion", "Motion model",
+          "How the boxes move between frames",
+          GST_TYPE_NVDSFAKEDETECT_MOTION, DEFAULT_MOTION,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+
+  g_object_class_install_property (gobject_class, PROP_SPEED,
+      g_param_spec_double ("speed", "Speed",
+          "Mean speed of the boxes in pixels per frame",
+          0.0, 1000.0, DEFAULT_SPEED,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+
+  g_object_class_install_property (gobject_class, PROP_CLASS_MIX,
+      g_param_spec_string ("class-mix", "Class mix",
+          "Class ids of the objects with optional relative weights, "
+          "e.g. \"0:7,2:3\" for 70% class 0 and 30% class 2",
+          DEFAULT_CLASS_MIX,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+
+  g_object_class_install_property (gobject_class, PROP_SEED,
+      g_param_spec_uint ("seed", "Seed",
+          "Seed of the generator, runs with the same seed produce the same "
+          "metadata", 0, G_MAXUINT, DEFAULT_SEED,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+
+  g_object_class_install_property (gobject_class, PROP_REPLAY_FILE,
+      g_param_spec_string ("replay-file", "Replay file",
+          "Play back the metadata recorded by nvdspostprocess record-file "
+          "instead of generating it, the stream ends with the recording. "
+          "Empty uses the generator",
+          DEFAULT_REPLAY_FILE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&gst_nvdsfakedetect_src_template));
+
+  /* Set metadata describing the element */
+  gst_element_class_set_details_simple (gstelement_class,
+      "gst-nvdsfakedetect plugin",
+      "Source/Video",
+      "Batched system memory surfaces with synthetic detection metadata, "
+      "to drive nvdspostprocess without nvstreammux and nvinfer",
+      "NVIDIA Corporation. Post on Deepstream for Tesla forum for any queries "
+      "@ https://devtalk.nvidia.com/default/board/209/");
+}
+
+static void
+gst_nvdsfakedetect_init (GstNvDsFakeDetect * fakedetect)
+{
+  GstBaseSrc *bsrc = GST_BASE_SRC (fakedetect);
+
+  gst_base_src_set_format (bsrc, GST_FORMAT_TIME);
+
+  /* Initialize all property variables to default values */
+  fakedetect->num_sources = DEFAULT_NUM_SOURCES;
+  fakedetect->width = DEFAULT_WIDTH;
+  fakedetect->height = DEFAULT_HEIGHT;
+  fakedetect->fps = DEFAULT_FPS;
+  fakedetect->is_live = DEFAULT_IS_LIVE;
+  fakedetect->objects_per_frame = DEFAULT_OBJECTS_PER_FRAME;
+  fakedetect->object_lifetime = DEFAULT_OBJECT_LIFETIME;
+  fakedetect->motion = DEFAULT_MOTION;
+  fakedetect->speed = DEFAULT_SPEED;
+  fakedetect->class_mix = g_strdup (DEFAULT_CLASS_MIX);
+  fakedetect->seed = DEFAULT_SEED;
+  fakedetect->replay_file = g_strdup (DEFAULT_REPLAY_FILE);
+}
+
+static void
+gst_nvdsfakedetect_finalize (GObject * object)
+{
+  GstNvDsFakeDetect *fakedetect = GST_NVDSFAKEDETECT (object);
+
+  g_free (fakedetect->class_mix);
+  g_free (fakedetect->replay_file);
+  std::vector<GstNvDsFakeDetectClassWeight> ().swap (fakedetect->class_weights);
+  std::vector<GstNvDsFakeDetectObject> ().swap (fakedetect->objects);
+  std::vector<void *> ().swap (fakedetect->cleared_surfaces);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+/* Function called when a property of the element is set. Standard boilerplate.
+ */
+static void
+gst_nvdsfakedetect_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstNvDsFakeDetect *fakedetect = GST_NVDSFAKEDETECT (object);
+  switch (prop_id) {
+    case PROP_NUM_SOURCES:
+      fakedetect->num_sources = g_value_get_uint (value);
+      break;
+    case PROP_WIDTH:
+      fakedetect->width = g_value_get_uint (value);
+      break;
+    case PROP_HEIGHT:
+      fakedetect->height = g_value_get_uint (value);
+      break;
+    case PROP_FPS:
+      fakedetect->fps = g_value_get_uint (value);
+      break;
+    case PROP_IS_LIVE:
+      fakedetect->is_live = g_value_get_boolean (value);
+      break;
+    case PROP_OBJECTS_PER_FRAME:
+      fakedetect->objects_per_frame = g_value_get_uint (value);
+      break;
+    case PROP_OBJECT_LIFETIME:
+      fakedetect->object_lifetime = g_value_get_uint (value);
+      break;
+    case PROP_MOTION:
+      fakedetect->motion = (GstNvDsFakeDetectMotion) g_value_get_enum (value);
+      break;
+    case PROP_SPEED:
+      fakedetect->speed = g_value_get_double (value);
+      break;
+    case PROP_CLASS_MIX:
+      g_free (fakedetect->class_mix);
+      fakedetect->class_mix = g_value_dup_string (value);
+      break;
+    case PROP_SEED:
+      fakedetect->seed = g_value_get_uint (value);
+      break;
+    case PROP_REPLAY_FILE:
+      g_free (fakedetect->replay_file);
+      fakedetect->replay_file = g_value_dup_string (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+/* Function called when a property of the element is requested. Standard
+ * boilerplate.
+ */
+static void
+gst_nvdsfakedetect_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstNvDsFakeDetect *fakedetect = GST_NVDSFAKEDETECT (object);
+
+  switch (prop_id) {
+    case PROP_NUM_SOURCES:
+      g_value_set_uint (value, fakedetect->num_sources);
+      break;
+    case PROP_WIDTH:
+      g_value_set_uint (value, fakedetect->width);
+      break;
+    case PROP_HEIGHT:
+      g_value_set_uint (value, fakedetect->height);
+      break;
+    case PROP_FPS:
+      g_value_set_uint (value, fakedetect->fps);
+      break;
+    case PROP_IS_LIVE:
+      g_value_set_boolean (value, fakedetect->is_live);
+      break;
+    case PROP_OBJECTS_PER_FRAME:
+      g_value_set_uint (value, fakedetect->objects_per_frame);
+      break;
+    case PROP_OBJECT_LIFETIME:
+      g_value_set_uint (value, fakedetect->object_lifetime);
+      break;
+    case PROP_MOTION:
+      g_value_set_enum (value, fakedetect->motion);
+      break;
+    case PROP_SPEED:
+      g_value_set_double (value, fakedetect->speed);
+      break;
+    case PROP_CLASS_MIX:
+      g_value_set_string (value, fakedetect->class_mix);
+      break;
+    case PROP_SEED:
+      g_value_set_uint (value, fakedetect->seed);
+      break;
+    case PROP_REPLAY_FILE:
+      g_value_set_string (value, fakedetect->replay_file);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+/* xorshift64*, cheap enough to draw several numbers per object. */
+static inline guint64
+gst_nvdsfakedetect_rand (GstNvDsFakeDetect * fakedetect)
+{
+  guint64 x = fakedetect->rng_state;
+
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  fakedetect->rng_state = x;
+  return x * 0x2545F4914F6CDD1DULL;
+}
+
+/* Uniform in [0, 1). */
+static inline gdouble
+gst_nvdsfakedetect_uniform (GstNvDsFakeDetect * fakedetect)
+{
+  return (gst_nvdsfakedetect_rand (fakedetect) >> 11) *
+      (1.0 / 9007199254740992.0);
+}
+
+/* Parse "class[:weight],..." into cumulative weights. */
+static gboolean
+gst_nvdsfakedetect_parse_class_mix (const gchar * class_mix,
+    std::vector<GstNvDsFakeDetectClassWeight> & weights)
+{
+  gchar **entries = g_strsplit (class_mix ? class_mix : "", ",", -1);
+  gdouble total = 0.0;
+  gboolean ok = TRUE;
+
+  weights.clear ();
+  for (gchar **entry = entries; *entry && ok; entry++) {
+    gchar *str = g_strstrip (*entry);
+    gchar *end;
+    gint64 class_id;
+    gdouble weight = 1.0;
+
+    if (!*str)
+      continue;
+    class_id = g_ascii_strtoll (str, &end, 10);
+    if (end == str || class_id < 0 || class_id > G_MAXINT) {
+      ok = FALSE;
+      break;
+    }
+    if (*end == ':') {
+      gchar *weight_str = end + 1;
+      weight = g_ascii_strtod (weight_str, &end);
+      if (end == weight_str || !(weight >= 0.0))
+        ok = FALSE;
+    }
+    if (*end)
+      ok = FALSE;
+    total += weight;
+    weights.push_back ({(gint) class_id, total});
+  }
+  g_strfreev (entries);
+
+  return ok && !weights.empty () && total > 0.0;
+}
+
+static gint
+gst_nvdsfakedetect_pick_class (GstNvDsFakeDetect * fakedetect)
+{
+  const std::vector<GstNvDsFakeDetectClassWeight> &weights =
+      fakedetect->class_weights;
+  gdouble pick = gst_nvdsfakedetect_uniform (fakedetect) *
+      weights.back ().cumulative;
+
+  for (const GstNvDsFakeDetectClassWeight & weight : weights)
+    if (pick < weight.cumulative)
+      return weight.class_id;
+  return weights.back ().class_id;
+}
+
+/* Place a new track at a random position with a random heading. */
+static void
+gst_nvdsfakedetect_spawn (GstNvDsFakeDetect * fakedetect,
+    GstNvDsFakeDetectObject * obj)
+{
+  gdouble box_width = fakedetect->width *
+      (FAKEDETECT_MIN_BOX_FRACTION + gst_nvdsfakedetect_uniform (fakedetect) *
+      (FAKEDETECT_MAX_BOX_FRACTION - FAKEDETECT_MIN_BOX_FRACTION));
+  gdouble box_height = MIN (box_width *
+      (1.0 + 1.5 * gst_nvdsfakedetect_uniform (fakedetect)),
+      (gdouble) fakedetect->height);
+  gdouble heading = 2.0 * M_PI * gst_nvdsfakedetect_uniform (fakedetect);
+  gdouble speed = fakedetect->speed *
+      (0.5 + gst_nvdsfakedetect_uniform (fakedetect));
+
+  obj->width = box_width;
+  obj->height = box_height;
+  obj->left = gst_nvdsfakedetect_uniform (fakedetect) *
+      (fakedetect->width - box_width);
+  obj->top = gst_nvdsfakedetect_uniform (fakedetect) *
+      (fakedetect->height - box_height);
+  obj->vx = speed * cos (heading);
+  obj->vy = speed * sin (heading);
+  obj->class_id = gst_nvdsfakedetect_pick_class (fakedetect);
+  obj->object_id = fakedetect->next_object_id++;
+  /* Uniform in [1, 2 * lifetime] so that tracks do not all end together. */
+  obj->frames_left = fakedetect->object_lifetime ? 1 +
+      (guint) (gst_nvdsfakedetect_uniform (fakedetect) *
+      (2 * fakedetect->object_lifetime)) : 0;
+}
+
+/* Move a coordinate by its velocity, reflecting it on [0, limit]. */
+static inline void
+gst_nvdsfakedetect_bounce (gfloat * pos, gfloat * velocity, gfloat limit)
+{
+  *pos += *velocity;
+  if (*pos < 0.0f) {
+    *pos = -*pos;
+    *velocity = -*velocity;
+  } else if (*pos > limit) {
+    *pos = 2.0f * limit - *pos;
+    *velocity = -*velocity;
+  }
+  *pos = CLAMP (*pos, 0.0f, limit);
+}
+
+/* Advance an object by one frame, replacing it when its track ends. */
+static void
+gst_nvdsfakedetect_step (GstNvDsFakeDetect * fakedetect,
+    GstNvDsFakeDetectObject * obj)
+{
+  if (obj->frames_left && !--obj->frames_left) {
+    gst_nvdsfakedetect_spawn (fakedetect, obj);
+    return;
+  }
+
+  switch (fakedetect->motion) {
+    case NVDSFAKEDETECT_MOTION_STATIC:
+      return;
+    case NVDSFAKEDETECT_MOTION_RANDOM_WALK:{
+      gfloat max_speed = 2.0 * fakedetect->speed;
+      gfloat jitter = 0.5 * fakedetect->speed;
+      gfloat norm;
+
+      obj->vx += (gst_nvdsfakedetect_uniform (fakedetect) - 0.5) * jitter;
+      obj->vy += (gst_nvdsfakedetect_uniform (fakedetect) - 0.5) * jitter;
+      norm = sqrtf (obj->vx * obj->vx + obj->vy * obj->vy);
+      if (norm > max_speed) {
+        obj->vx *= max_speed / norm;
+        obj->vy *= max_speed / norm;
+      }
+    }
+      /* fall through */
+    case NVDSFAKEDETECT_MOTION_LINEAR:
+      gst_nvdsfakedetect_bounce (&obj->left, &obj->vx,
+          fakedetect->width - obj->width);
+      gst_nvdsfakedetect_bounce (&obj->top, &obj->vy,
+          fakedetect->height - obj->height);
+      break;
+  }
+}
+
+/* Fixed caps built from the properties. */
+static GstCaps *
+gst_nvdsfakedetect_get_caps (GstBaseSrc * bsrc, GstCaps * filter)
+{
+  GstNvDsFakeDetect *fakedetect = GST_NVDSFAKEDETECT (bsrc);
+  GstCaps *caps = gst_caps_new_simple ("video/x-raw",
+      "format", G_TYPE_STRING, "RGBA",
+      "width", G_TYPE_INT, (gint) fakedetect->width,
+      "height", G_TYPE_INT, (gint) fakedetect->height,
+      "framerate", GST_TYPE_FRACTION, (gint) fakedetect->fps, 1, NULL);
+
+  gst_caps_set_features (caps, 0,
+      gst_caps_features_new (GST_CAPS_FEATURE_MEMORY_NVMM, NULL));
+
+  if (filter) {
+    GstCaps *tmp = gst_caps_intersect_full (filter, caps,
+        GST_CAPS_INTERSECT_FIRST);
+    gst_caps_unref (caps);
+    caps = tmp;
+  }
+  return caps;
+}
+
+/* Batched system memory surfaces, the same layout nvstreammux outputs, so
+ * that no GPU is needed. */
+static gboolean
+gst_nvdsfakedetect_decide_allocation (GstBaseSrc * bsrc, GstQuery * query)
+{
+  GstNvDsFakeDetect *fakedetect = GST_NVDSFAKEDETECT (bsrc);
+  GstCaps *caps = NULL;
+  GstBufferPool *pool;
+  GstStructure *config;
+
+  gst_query_parse_allocation (query, &caps, NULL);
+  if (!caps) {
+    GST_ELEMENT_ERROR (fakedetect, CORE, NEGOTIATION,
+        ("No caps in the allocation query"), (NULL));
+    return FALSE;
+  }
+
+  pool = gst_nvds_buffer_pool_new ();
+  config = gst_buffer_pool_get_config (pool);
+  gst_buffer_pool_config_set_params (config, caps, sizeof (NvBufSurface),
+      DEFAULT_BUF_POOL_SIZE, DEFAULT_BUF_POOL_SIZE);
+  gst_structure_set (config,
+      "memtype", G_TYPE_UINT, NVBUF_MEM_SYSTEM,
+      "gpu-id", G_TYPE_UINT, 0,
+      "batch-size", G_TYPE_UINT, fakedetect->num_sources, NULL);
+
+  if (!gst_buffer_pool_set_config (pool, config)) {
+    GST_ELEMENT_ERROR (fakedetect, RESOURCE, FAILED,
+        ("Failed to configure the batched surface pool"),
+        ("%u x %ux%u system memory", fakedetect->batch_size,
+            fakedetect->width, fakedetect->height));
+    gst_object_unref (pool);
+    return FALSE;
+  }
+
+  if (gst_query_get_n_allocation_pools (query) > 0)
+    gst_query_set_nth_allocation_pool (query, 0, pool, sizeof (NvBufSurface),
+        DEFAULT_BUF_POOL_SIZE, DEFAULT_BUF_POOL_SIZE);
+  else
+    gst_query_add_allocation_pool (query, pool, sizeof (NvBufSurface),
+        DEFAULT_BUF_POOL_SIZE, DEFAULT_BUF_POOL_SIZE);
+  gst_object_unref (pool);
+
+  return TRUE;
+}
+
+/**
+ * Initialize the generator when the element goes from READY to PAUSED.
+ */
+/* Map the recording and size the batches on its largest one. */
+static gboolean
+gst_nvdsfakedetect_open_replay (GstNvDsFakeDetect * fakedetect)
+{
+  RecordBatchView view;
+  guint64 num_batches = 0;
+
+  fakedetect->replay_reader = record_reader_open (fakedetect->replay_file);
+  if (!fakedetect->replay_reader) {
+    GST_ELEMENT_ERROR (fakedetect, RESOURCE, OPEN_READ,
+        ("Could not open replay file"),
+        ("%s: %s", fakedetect->replay_file, g_strerror (errno)));
+    return FALSE;
+  }
+
+  fakedetect->batch_size = 1;
+  while (record_reader_next (fakedetect->replay_reader, &view)) {
+    if (!num_batches++)
+      fakedetect->replay_first_pts = view.pts;
+    fakedetect->batch_size = MAX (fakedetect->batch_size, view.num_frames);
+  }
+  record_reader_rewind (fakedetect->replay_reader);
+
+  if (!num_batches) {
+    GST_ELEMENT_ERROR (fakedetect, RESOURCE, READ,
+        ("Replay file holds no batch"), ("%s", fakedetect->replay_file));
+    record_reader_close (fakedetect->replay_reader);
+    fakedetect->replay_reader = NULL;
+    return FALSE;
+  }
+
+  GST_DEBUG_OBJECT (fakedetect, "replaying %lu batches of up to %u frames",
+      (gulong) num_batches, fakedetect->batch_size);
+  return TRUE;
+}
+
+static gboolean
+gst_nvdsfakedetect_start (GstBaseSrc * bsrc)
+{
+  GstNvDsFakeDetect *fakedetect = GST_NVDSFAKEDETECT (bsrc);
+
+  fakedetect->frame_num = 0;
+  fakedetect->cleared_surfaces.clear ();
+  gst_base_src_set_live (bsrc, fakedetect->is_live);
+
+  if (fakedetect->replay_file && strlen (fakedetect->replay_file))
+    return gst_nvdsfakedetect_open_replay (fakedetect);
+
+  fakedetect->batch_size = fakedetect->num_sources;
+
+  if (!gst_nvdsfakedetect_parse_class_mix (fakedetect->class_mix,
+          fakedetect->class_weights)) {
+    GST_ELEMENT_ERROR (fakedetect, LIBRARY, SETTINGS,
+        ("Invalid class-mix \"%s\"", fakedetect->class_mix),
+        ("expected class[:weight],... with at least one positive weight"));
+    return FALSE;
+  }
+
+  /* Never 0, xorshift would stay stuck on it. */
+  fakedetect->rng_state = (fakedetect->seed + 1) * 0x9E3779B97F4A7C15ULL;
+  fakedetect->next_object_id = 0;
+
+  fakedetect->objects.resize ((gsize) fakedetect->num_sources *
+      fakedetect->objects_per_frame);
+  for (GstNvDsFakeDetectObject & obj : fakedetect->objects)
+    gst_nvdsfakedetect_spawn (fakedetect, &obj);
+
+  GST_DEBUG_OBJECT (fakedetect, "%u sources x %u objects, %ux%u @ %u fps",
+      fakedetect->num_sources, fakedetect->objects_per_frame,
+      fakedetect->width, fakedetect->height, fakedetect->fps);
+
+  return TRUE;
+}
+
+/**
+ * Free the generator state when the element goes from PAUSED to READY.
+ */
+static gboolean
+gst_nvdsfakedetect_stop (GstBaseSrc * bsrc)
+{
+  GstNvDsFakeDetect *fakedetect = GST_NVDSFAKEDETECT (bsrc);
+
+  std::vector<GstNvDsFakeDetectObject> ().swap (fakedetect->objects);
+  fakedetect->cleared_surfaces.clear ();
+  if (fakedetect->replay_reader) {
+    record_reader_close (fakedetect->replay_reader);
+    fakedetect->replay_reader = NULL;
+  }
+
+  return TRUE;
+}
+
+/* Frame meta of the surface batch_id of the batch. */
+static NvDsFrameMeta *
+gst_nvdsfakedetect_add_frame (GstNvDsFakeDetect * fakedetect,
+    NvDsBatchMeta * batch_meta, guint batch_id, guint source_id,
+    gint frame_num, GstClockTime pts)
+{
+  NvDsFrameMeta *frame_meta = nvds_acquire_frame_meta_from_pool (batch_meta);
+
+  frame_meta->pad_index = source_id;
+  frame_meta->source_id = source_id;
+  frame_meta->batch_id = batch_id;
+  frame_meta->frame_num = frame_num;
+  frame_meta->buf_pts = pts;
+  frame_meta->ntp_timestamp = pts;
+  frame_meta->num_surfaces_per_frame = 1;
+  frame_meta->source_frame_width = fakedetect->width;
+  frame_meta->source_frame_height = fakedetect->height;
+  frame_meta->bInferDone = TRUE;
+  nvds_add_frame_meta_to_batch (batch_meta, frame_meta);
+  return frame_meta;
+}
+
+/* Object meta as a primary detector followed by a tracker would attach it. */
+static void
+gst_nvdsfakedetect_add_object (NvDsBatchMeta * batch_meta,
+    NvDsFrameMeta * frame_meta, gint class_id, guint64 object_id,
+    gfloat confidence, gfloat left, gfloat top, gfloat width, gfloat height)
+{
+  NvDsObjectMeta *obj_meta = nvds_acquire_obj_meta_from_pool (batch_meta);
+  NvOSD_RectParams *rect = &obj_meta->rect_params;
+
+  obj_meta->unique_component_id = FAKEDETECT_COMPONENT_ID;
+  obj_meta->class_id = class_id;
+  obj_meta->object_id = object_id;
+  obj_meta->confidence = confidence;
+  obj_meta->tracker_confidence = 1.0;
+  rect->left = left;
+  rect->top = top;
+  rect->width = width;
+  rect->height = height;
+  obj_meta->detector_bbox_info.org_bbox_coords.left = left;
+  obj_meta->detector_bbox_info.org_bbox_coords.top = top;
+  obj_meta->detector_bbox_info.org_bbox_coords.width = width;
+  obj_meta->detector_bbox_info.org_bbox_coords.height = height;
+  obj_meta->tracker_bbox_info.org_bbox_coords =
+      obj_meta->detector_bbox_info.org_bbox_coords;
+  nvds_add_obj_meta_to_frame (frame_meta, obj_meta, NULL);
+}
+
+/* Current state of every source, then advance the objects by one frame. */
+static void
+gst_nvdsfakedetect_fill_generated (GstNvDsFakeDetect * fakedetect,
+    NvDsBatchMeta * batch_meta, GstClockTime pts)
+{
+  GstNvDsFakeDetectObject *obj = fakedetect->objects.data ();
+
+  for (guint source_id = 0; source_id < fakedetect->num_sources; source_id++) {
+    NvDsFrameMeta *frame_meta = gst_nvdsfakedetect_add_frame (fakedetect,
+        batch_meta, source_id, source_id, (gint) fakedetect->frame_num, pts);
+
+    for (guint i = 0; i < fakedetect->objects_per_frame; i++, obj++) {
+      gst_nvdsfakedetect_add_object (batch_meta, frame_meta, obj->class_id,
+          obj->object_id, 1.0, obj->left, obj->top, obj->width, obj->height);
+      gst_nvdsfakedetect_step (fakedetect, obj);
+    }
+  }
+}
+
+/* Frames and objects of a recorded batch, as they entered nvdspostprocess. */
+static void
+gst_nvdsfakedetect_fill_replayed (GstNvDsFakeDetect * fakedetect,
+    NvDsBatchMeta * batch_meta, const RecordBatchView * view)
+{
+  guint obj = 0;
+
+  for (guint i = 0; i < view->num_frames; i++) {
+    NvDsFrameMeta *frame_meta = gst_nvdsfakedetect_add_frame (fakedetect,
+        batch_meta, i, view->source_id[i], view->frame_num[i],
+        view->frame_pts[i]);
+
+    for (guint n = 0; n < view->frame_num_objects[i] &&
+        obj < view->num_objects; n++, obj++) {
+      gst_nvdsfakedetect_add_object (batch_meta, frame_meta,
+          view->class_id[obj], view->object_id[obj], view->confidence[obj],
+          view->left[obj], view->top[obj], view->width[obj],
+          view->height[obj]);
+    }
+  }
+}
+
+/**
+ * Attach the batch meta, generated or read from the replay file, to a pool
+ * buffer.
+ */
+static GstFlowReturn
+gst_nvdsfakedetect_fill (GstBaseSrc * bsrc, guint64 offset, guint size,
+    GstBuffer * buf)
+{
+  GstNvDsFakeDetect *fakedetect = GST_NVDSFAKEDETECT (bsrc);
+  GstMapInfo map_info;
+  NvBufSurface *surf;
+  NvDsBatchMeta *batch_meta;
+  NvDsMeta *meta;
+  RecordBatchView view;
+  guint num_frames = fakedetect->batch_size;
+  GstClockTime pts = gst_util_uint64_scale (fakedetect->frame_num, GST_SECOND,
+      fakedetect->fps);
+
+  if (fakedetect->replay_reader) {
+    if (!record_reader_next (fakedetect->replay_reader, &view)) {
+      GST_DEBUG_OBJECT (fakedetect, "end of the replay file");
+      return GST_FLOW_EOS;
+    }
+    num_frames = MIN (view.num_frames, fakedetect->batch_size);
+    /* Keep the recorded pacing, a syncing sink replays in real time. */
+    if (GST_CLOCK_TIME_IS_VALID (view.pts) &&
+        view.pts >= fakedetect->replay_first_pts)
+      pts = view.pts - fakedetect->replay_first_pts;
+  }
+
+  memset (&map_info, 0, sizeof (map_info));
+  if (!gst_buffer_map (buf, &map_info, GST_MAP_READWRITE)) {
+    GST_ELEMENT_ERROR (fakedetect, STREAM, FAILED,
+        ("%s:gst buffer map to get pointer to NvBufSurface failed", __func__), (NULL));
+    return GST_FLOW_ERROR;
+  }
+  surf = (NvBufSurface *) map_info.data;
+  surf->numFilled = num_frames;
+  /* First use of this pool buffer, start from black frames. */
+  if (std::find (fakedetect->cleared_surfaces.begin (),
+          fakedetect->cleared_surfaces.end (), surf->surfaceList[0].dataPtr) ==
+      fakedetect->cleared_surfaces.end ()) {
+    NvBufSurfaceMemSet (surf, -1, -1, 0);
+    fakedetect->cleared_surfaces.push_back (surf->surfaceList[0].dataPtr);
+  }
+  gst_buffer_unmap (buf, &map_info);
+
+  batch_meta = nvds_create_batch_meta (fakedetect->batch_size);
+  meta = gst_buffer_add_nvds_meta (buf, batch_meta, NULL,
+      nvds_batch_meta_copy_func, nvds_batch_meta_release_func);
+  meta->meta_type = NVDS_BATCH_GST_META;
+  batch_meta->base_meta.batch_meta = batch_meta;
+  batch_meta->base_meta.copy_func = nvds_batch_meta_copy_func;
+  batch_meta->base_meta.release_func = nvds_batch_meta_release_func;
+  batch_meta->max_frames_in_batch = fakedetect->batch_size;
+
+  if (fakedetect->replay_reader) {
+    view.num_frames = num_frames;
+    gst_nvdsfakedetect_fill_replayed (fakedetect, batch_meta, &view);
+  } else {
+    gst_nvdsfakedetect_fill_generated (fakedetect, batch_meta, pts);
+  }
+
+  GST_BUFFER_PTS (buf) = pts;
+  GST_BUFFER_DTS (buf) = GST_CLOCK_TIME_NONE;
+  GST_BUFFER_DURATION (buf) = gst_util_uint64_scale (fakedetect->frame_num + 1,
+      GST_SECOND, fakedetect->fps) - gst_util_uint64_scale (
+      fakedetect->frame_num, GST_SECOND, fakedetect->fps);
+  GST_BUFFER_OFFSET (buf) = fakedetect->frame_num;
+  GST_BUFFER_OFFSET_END (buf) = fakedetect->frame_num + 1;
+  fakedetect->frame_num++;
+
+  return GST_FLOW_OK;
+}
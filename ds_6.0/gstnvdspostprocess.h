@@ -37,6 +37,7 @@
 #include <unordered_map>
 #include <functional>
 
+#include <string>
 #include <vector>
 #include <cuda.h>
 #include <cuda_runtime.h>
@@ -50,6 +51,17 @@
 #include "nvtx3/nvToolsExt.h"
 #include <unordered_map>
 
+#include "nvdspostprocess_analytics.h"
+#include "nvdspostprocess_overlay.h"
+#include "nvdspostprocess_text.h"
+#include "nvdspostprocess_tiler.h"
+#include "nvdspostprocess_stats.h"
+#include "nvdspostprocess_trace.h"
+#include "nvdspostprocess_metrics.h"
+#include "nvdspostprocess_record.h"
+#include "nvdspostprocess_arena.h"
+#include "nvdspostprocess_heatmap.h"
+
 
 /* Package and library details required for plugin_init */
 #define PACKAGE "nvdsvideotemplate"
@@ -81,11 +93,137 @@ typedef struct
 } Point;
 
 
+/** zones per source, bounded by the width of the per track zone mask */
+#define NVDSPOSTPROCESS_MAX_ZONES ANALYTICS_MAX_ZONES
+
+/** sources with throughput counters, higher source ids are not tracked */
+#define NVDSPOSTPROCESS_MAX_SOURCES 1024
+
+/** zone_min_overlap-N when it is not set */
+#define NVDSPOSTPROCESS_DEFAULT_MIN_OVERLAP 0.5
+
+/** zone_approach values */
+#define NVDSPOSTPROCESS_APPROACH_OCCUPANCY 0
+#define NVDSPOSTPROCESS_APPROACH_ENTRIES 1
+
+/** user meta type of NvDsPostProcessZoneCountMeta attached to frames */
+#define NVDS_POSTPROCESS_ZONE_COUNT_META \
+  (nvds_get_user_meta_type ((gchar *) "NVIDIA.NVDSPOSTPROCESS.ZONE_COUNT"))
+
+/** zone counts of a frame, attached as frame user meta */
+typedef struct
+{
+  /** source the counts belong to */
+  guint source_id;
+  /** number of valid entries in the arrays */
+  guint num_zones;
+  /** zone ids as listed in zone_ids */
+  gint zone_ids[NVDSPOSTPROCESS_MAX_ZONES];
+  /** counted objects inside the zone in this frame */
+  guint occupancy[NVDSPOSTPROCESS_MAX_ZONES];
+  /** tracks that entered the zone since the element started */
+  guint64 entries[NVDSPOSTPROCESS_MAX_ZONES];
+  /** fraction of the zone covered by counted boxes, 0 unless
+   * zone_coverage-N is set */
+  gfloat coverage[NVDSPOSTPROCESS_MAX_ZONES];
+} NvDsPostProcessZoneCountMeta;
+
+/** processing stages timed by the latency histograms */
+typedef enum
+{
+  /** collect the objects of the frames with zones */
+  NVDSPOSTPROCESS_STAGE_GATHER,
+  /** test the object anchors against the zones */
+  NVDSPOSTPROCESS_STAGE_ZONE_TEST,
+  /** update the track zone membership and entry counts */
+  NVDSPOSTPROCESS_STAGE_TRACK_UPDATE,
+  /** attach the counts and drop the uncounted objects */
+  NVDSPOSTPROCESS_STAGE_META_ATTACH,
+  /** draw zones, labels and boxes */
+  NVDSPOSTPROCESS_STAGE_OVERLAY,
+  /** compose the mosaic */
+  NVDSPOSTPROCESS_STAGE_TILER,
+  /** push downstream */
+  NVDSPOSTPROCESS_STAGE_PAD_PUSH,
+  /** element latency, from reception to the hand-off to gst_pad_push */
+  NVDSPOSTPROCESS_STAGE_ELEMENT,
+  /** whole batch, from reception to the end of the push */
+  NVDSPOSTPROCESS_STAGE_BATCH,
+  NVDSPOSTPROCESS_STAGE_COUNT
+} GstNvDsPostProcessStage;
+
+/** content of a mosaic tile */
+typedef enum
+{
+  /** never written, pool buffers come uninitialized */
+  NVDSPOSTPROCESS_TILE_UNKNOWN,
+  /** cleared, no frame of the source was seen yet */
+  NVDSPOSTPROCESS_TILE_BLACK,
+  /** holds the frame identified by the stamp */
+  NVDSPOSTPROCESS_TILE_FRAME
+} GstNvDsPostProcessTileState;
+
+/** work given up, in this order, when the element runs over its budget */
+typedef enum
+{
+  NVDSPOSTPROCESS_SHED_NONE,
+  /** skip the overlay */
+  NVDSPOSTPROCESS_SHED_OVERLAY,
+  /** leave the objects under shed-min-confidence out of the counts */
+  NVDSPOSTPROCESS_SHED_LOW_CONFIDENCE,
+  /** analyse only every shed-interval frame of the low_priority sources */
+  NVDSPOSTPROCESS_SHED_INTERVAL,
+  NVDSPOSTPROCESS_SHED_LEVEL_COUNT
+} GstNvDsPostProcessShedLevel;
+
+/** identifies the frame composed into a mosaic tile */
+typedef struct
+{
+  GstNvDsPostProcessTileState state;
+  guint source_id;
+  gint frame_num;
+  guint64 buf_pts;
+} GstNvDsPostProcessTileStamp;
+
+/** tiles held by one mosaic buffer of the pool */
+typedef struct
+{
+  /** plane of the pool buffer */
+  gpointer data;
+  /** stamp of every tile */
+  std::vector<GstNvDsPostProcessTileStamp> stamps;
+} GstNvDsPostProcessTilerSlot;
+
 typedef  std::vector<Point> Points;
 typedef  std::vector<gint> gintvec;
 typedef  std::vector<gdouble> gdoublevec;
 
 
+/**
+ *  struct denoting properties set by config file
+ */
+typedef struct {
+  /** for config param : enable*/
+  gboolean enable;
+  /** for config param : object_ids*/
+  gboolean object_ids;
+  /** for config param : custom-lib-path */
+  gboolean custom_lib_path;
+  /** for config param : custom-tensor-function-name */
+  gboolean custom_tensor_function_name;
+  /** for config param : zone_ids */
+  gboolean zone_ids;
+  /** for config param : fcm_factor */
+  gboolean fcm_factor;
+  /** for config param : zone_cords */
+  gboolean zone_cords;
+  /** for config param : zone_approach */
+  gboolean zone_approach;
+  /** for config param : remove_uncounted */
+  gboolean remove_uncounted;
+} NvDsPostProcessPropertySet;
+
+/** [source-N] group of a config file, shared by the instances using it */
 typedef struct
 {
   /**src_id */
@@ -114,41 +252,224 @@ typedef struct
   
   gintvec zone_ids; 
 
+  /** membership rule of zone N from zone_anchor-N and zone_min_overlap-N,
+   * missing entries use the bottom centre */
+  std::vector<AnalyticsZoneAnchor> zone_anchors;
+
+  /** zone N measures its coverage when zone_coverage-N is set */
+  gintvec zone_coverage;
+
   /** boolean indicating if processing on src or not */
   gboolean enable = 0;
+
+  /** analyse every interval-th frame of the source */
+  guint interval = 1;
+
+  /** put on shed-interval when shedding load */
+  gboolean low_priority = FALSE;
+
+  /** zone_pts compiled for the analytics engine, with their anchors and
+   * coverage grids */
+  AnalyticsZoneSet zone_set;
+
+  /** zone_pts compiled for the overlay rasterizer */
+  std::vector<OverlayPolygon> overlay_zones;
+} GstNvDsPostProcessGroupConfig;
+
+/**
+ * Parsed config file. Instances given the same file share one copy through
+ * the process-wide cache of nvdspostprocess_config_acquire, it is never
+ * modified once parsed.
+ */
+typedef struct
+{
+  /** canonical path and content hash the cache knows it by */
+  std::string key;
+
+  /** instances holding it, protected by the cache lock */
+  guint refcount = 0;
+
+  /** enable of [property], -1 when absent */
+  gint enable = -1;
+
+  std::vector<gint> object_ids;
+
+  /** properties set by the config file */
+  NvDsPostProcessPropertySet property_set = {};
+
+  gchar *custom_lib_path = NULL;
+
+  gchar *custom_tensor_function_name = NULL;
+
+  /** [source-N] groups in file order */
+  std::vector<GstNvDsPostProcessGroupConfig *> groups;
+} GstNvDsPostProcessConfig;
+
+/** per instance state of a [source-N] group */
+typedef struct
+{
+  /** group of the shared config */
+  const GstNvDsPostProcessGroupConfig *config;
+
+  /**src_id */
+  guint64 src_id;
+
+  /** cached count label per zone */
+  std::vector<TextLabel> zone_labels;
+
+  /** counts and tracks of the source, over the zones of config */
+  AnalyticsSource analytics;
+
+  /** analyse every interval-th frame of the source and extrapolate the
+   * others, changed at runtime by the source-interval property */
+  std::atomic<guint> interval{1};
+
+  /** frames of the source gathered so far, streaming thread only */
+  guint64 interval_frames = 0;
+
+  /** zone counts of the last frame, published for readers on other threads */
+  std::atomic<guint64> pub_occupancy[NVDSPOSTPROCESS_MAX_ZONES];
+  std::atomic<guint64> pub_entries[NVDSPOSTPROCESS_MAX_ZONES];
+  std::atomic<gfloat> pub_coverage[NVDSPOSTPROCESS_MAX_ZONES];
+
+  /** where the counted objects of the source stand, when heatmap-location
+   * is set */
+  Heatmap heatmap;
   
   
 
 
 } GstNvDsPostProcessGroup;
 
+/** frame of the batch being counted */
+typedef struct
+{
+  NvDsFrameMeta *frame_meta;
+  GstNvDsPostProcessGroup *group;
+  /** range of the frame in the gathered objects */
+  guint first_object;
+  guint num_objects;
+  /** not analysed: skipped by the source interval, load shedding or QoS */
+  gboolean interpolated;
+} GstNvDsPostProcessFrameWork;
+
+/** objects of the batch being counted as parallel arrays */
+typedef struct
+{
+  gfloat *left;
+  gfloat *top;
+  gfloat *width;
+  gfloat *height;
+  gint *class_id;
+  guint64 *object_id;
+  gfloat *confidence;
+  /** index of the object's frame in work_frames */
+  guint *frame;
+  guint8 *counted;
+  guint64 *zone_mask;
+  /** metadata the results are written back to */
+  NvDsObjectMeta **obj_meta;
+} GstNvDsPostProcessObjectWork;
+
+/** batch between its reception and its push downstream */
+typedef struct
+{
+  GstBuffer *inbuf;
+  GstMapInfo in_map_info;
+  NvBufSurface *in_surf;
+  NvDsBatchMeta *batch_meta;
+  /** current_batch_num when the batch was received */
+  gulong batch_num;
+  /** reception time, start of the element latency */
+  guint64 received;
+  /** start of the running stage */
+  guint64 stage_start;
+  nvtxRangeId_t nvtx_range;
+  /** handed to the output thread and not pushed yet */
+  gboolean in_flight;
+  /** GstNvDsPostProcessShedLevel when the batch was gathered */
+  guint shed_level;
+  /** too late for the downstream QoS, its frames are not analysed */
+  gboolean late;
+  /** scratch of the batch, reset once it is pushed */
+  ScratchArena arena;
+  /** frames and objects of the batch being counted, in arena */
+  GstNvDsPostProcessFrameWork *frames;
+  guint num_frames;
+  GstNvDsPostProcessObjectWork objects;
+  guint num_objects;
+} GstNvDsPostProcessBatch;
+
+/** batches in flight in async mode, one gathered while the other is pushed */
+#define NVDSPOSTPROCESS_PIPELINE_DEPTH 2
 
+/**
+ * C++ state of the element. GObject zero fills the instance and never runs
+ * constructors nor destructors, so these members live in the instance
+ * private data, constructed in place by init and destroyed by finalize.
+ */
+typedef struct
+{
+  /** state of the groups of config */
+  std::vector<GstNvDsPostProcessGroup*> nvdspostprocess_groups;
 
+  /** batches being processed, only the first one is used unless async */
+  GstNvDsPostProcessBatch batches[NVDSPOSTPROCESS_PIPELINE_DEPTH];
 
+  /** groups indexed by source id, NULL for sources without a group */
+  std::vector<GstNvDsPostProcessGroup*> src_groups;
 
-/**
- *  struct denoting properties set by config file
- */
-typedef struct {
-  /** for config param : enable*/
-  gboolean enable;
-  /** for config param : object_ids*/
-  gboolean object_ids;
-  /** for config param : custom-lib-path */
-  gboolean custom_lib_path;
-  /** for config param : custom-tensor-function-name */
-  gboolean custom_tensor_function_name;
-  /** for config param : zone_ids */
-  gboolean zone_ids;
-  /** for config param : fcm_factor */
-  gboolean fcm_factor;
-  /** for config param : zone_cords */
-  gboolean zone_cords;
-  /** for config param : zone_approach */
-  gboolean zone_approach;
-  /** for config param : remove_uncounted */
-  gboolean remove_uncounted;
-} NvDsPostProcessPropertySet;
+  /** surface the overlay is drawing into, with its dirty regions */
+  OverlaySurface overlay_surface;
+
+  /** scanline scratch reused across frames */
+  OverlayScratch overlay_scratch;
+
+  /** glyph atlas rasterized at start */
+  TextAtlas text_atlas;
+
+  /** tile contents of every pool buffer seen so far */
+  std::vector<GstNvDsPostProcessTilerSlot> tiler_slots;
+
+  /** newest frame of every tile */
+  std::vector<GstNvDsPostProcessTileStamp> tiler_latest;
+
+  /** resampler of every tile, sources may have different resolutions */
+  std::vector<TilerScaler> tiler_scalers;
+
+  /** bytes of the batch arenas used per batch and their total block size */
+  LatencyHistogram arena_usage;
+  std::atomic<guint64> arena_size;
+
+  /** latency of every processing stage */
+  LatencyHistogram stage_latency[NVDSPOSTPROCESS_STAGE_COUNT];
+
+  /** buffers that went over the latency budget */
+  std::atomic<guint64> budget_exceeded;
+
+  /** GstNvDsPostProcessShedLevel in effect, set on the output side */
+  std::atomic<guint> shed_level;
+
+  /** overlays skipped, objects left out and frames interpolated when
+   * shedding, and level changes */
+  std::atomic<guint64> shed_overlays;
+  std::atomic<guint64> shed_objects;
+  std::atomic<guint64> shed_frames;
+  std::atomic<guint64> shed_raised;
+  std::atomic<guint64> shed_lowered;
+
+  /** batches pushed without analysis because they were late */
+  std::atomic<guint64> qos_late_batches;
+
+  /** output_cpus parsed at start */
+  std::vector<int> output_cpu_list;
+
+  /** columns of the batch being recorded */
+  RecordBatch record_batch;
+
+  /** GstFlowReturn returned by the latest buffer pad push. */
+  std::atomic<GstFlowReturn> last_flow_ret;
+} GstNvDsPostProcessPrivate;
 
 /**
  * Strucuture containing Postprocess info
@@ -157,16 +478,12 @@ struct _GstNvDsPostProcess
 {
   /** Gst Base Transform */
   GstBaseTransform base_trans;
-   
-  /** Object ids */
-  std::vector <gint> object_ids;
-
 
-  /** group information as specified in config file */
-  std::vector<GstNvDsPostProcessGroup*> nvdspostprocess_groups;
-
-  /** struct denoting properties set by config file */
-  NvDsPostProcessPropertySet property_set;
+  /** C++ members, constructed in init */
+  GstNvDsPostProcessPrivate *priv;
+   
+  /** config file shared with the other instances using it */
+  const GstNvDsPostProcessConfig *config;
 
   /** pointer to the custom lib ctx */
   //CustomCtx* custom_lib_ctx;
@@ -177,11 +494,6 @@ struct _GstNvDsPostProcess
   /** custom lib handle */
   void* custom_lib_handle;
 
-  /** Custom Library Name */
-  gchar* custom_lib_path;
-
-  /** custom tensor function name */
-  gchar* custom_tensor_function_name;
 
   /** wrapper to custom tensor function */
   //std::function <NvDsPreProcessStatus(CustomCtx *, NvDsPreProcessBatch *, NvDsPreProcessCustomBuf *&,
@@ -205,6 +517,15 @@ struct _GstNvDsPostProcess
   /** Boolean to signal output thread to stop. */
   gboolean stop;
 
+  /** count and push the batches on output_thread, gathering the next batch
+   * on the streaming thread meanwhile */
+  gboolean async;
+
+  /** next batch gathered by the streaming thread and pushed by
+   * output_thread, protected by postprocess_lock */
+  guint gather_batch;
+  guint output_batch;
+
   /** Unique ID of the element. Used to identify metadata
    *  generated by this element. */
   guint unique_id;
@@ -225,13 +546,131 @@ struct _GstNvDsPostProcess
   /** Config file parsing status **/
   gboolean config_file_parse_successful;
 
+  /** set from start to stop, the groups are in use and config-file is
+   * refused, protected by postprocess_lock */
+  gboolean started;
+
+  /** draw zones and boxes into CPU accessible surfaces */
+  gboolean overlay;
+
+  /** border thickness in pixels for zone outlines and boxes */
+  guint overlay_border_width;
+
+  /** opacity of the zone tint */
+  gdouble overlay_zone_alpha;
+
+  /** integer scale of the label font */
+  guint overlay_font_scale;
+
+  /** warning about non CPU accessible memory already posted */
+  gboolean overlay_mem_warned;
+
+  /** mosaic grid, tiling is disabled when either is 0 */
+  guint tiler_rows;
+  guint tiler_columns;
+
+  /** mosaic resolution */
+  guint tiler_width;
+  guint tiler_height;
+
+  /** pool of the mosaic buffers, created on the first tiled batch */
+  GstBufferPool *tiler_pool;
+
+  /** last mosaic pushed, tiles of sources missing from a batch come from it */
+  GstBuffer *tiler_last_buf;
+
+  /** milliseconds between two stats messages, 0 disables them */
+  guint stats_interval;
+
+  /** time the last stats message was posted */
+  guint64 stats_last_post_ns;
+
+  /** element latency budget in microseconds, 0 disables the check */
+  guint latency_budget_us;
+
+  /** post a message for every buffer over the budget */
+  gboolean latency_budget_report;
+
+  /** give up work by priority while the element latency is over budget */
+  gboolean load_shedding;
+
+  /** objects under this confidence are not counted when shedding */
+  gdouble shed_min_confidence;
+
+  /** interval of the low_priority sources when shedding */
+  guint shed_interval;
+
+  /** smoothed element latency in ns, the projected cost of a batch */
+  gdouble shed_latency_ewma;
+
+  /** batches since the level changed, and in a row well under budget */
+  guint shed_hold;
+  guint shed_calm;
+
+  /** batches later than this for the downstream QoS are not analysed */
+  guint qos_lateness_us;
+
+  /** running time downstream has reached according to its QoS events,
+   * GST_CLOCK_TIME_NONE until the first one, protected by the object lock */
+  GstClockTime qos_earliest_time;
+
+  /** throughput counters indexed by source id */
+  SourceCounters *source_counters;
+
+  /** port of the Prometheus endpoint, 0 disables it */
+  guint metrics_port;
+
+  /** address the Prometheus endpoint listens on */
+  gchar *metrics_bind_address;
+
+  /** Prometheus endpoint while running */
+  MetricsServer *metrics_server;
+
+  /** element name, copied for the metrics labels */
+  gchar *metrics_name;
+
+  /** Chrome trace JSON output, empty disables tracing */
+  gchar *trace_file;
+
+  /** background writer of trace_file while running */
+  TraceWriter *trace_writer;
+
+  /** metadata recording output, empty disables recording */
+  gchar *record_file;
+
+  /** background writer of record_file while running */
+  RecordWriter *record_writer;
+
+  /** source:interval,... overriding the interval of the groups */
+  gchar *source_interval;
+
+  /** CPU list the output thread is pinned to, empty leaves it free */
+  gchar *output_cpus;
+
+  /** directory the source heatmaps are exported to, empty disables them */
+  gchar *heatmap_location;
+
+  /** heatmap grid, half-life in analysed frames (0 accumulates) and
+   * seconds between two exports */
+  guint heatmap_columns;
+  guint heatmap_rows;
+  guint heatmap_half_life;
+  guint heatmap_interval;
+
+  /** background writer of the heatmaps while running */
+  HeatmapWriter *heatmap_writer;
+
+  /** time of the last heatmap export */
+  guint64 heatmap_last_export_ns;
+
+  /** frame size of the negotiated input caps, the heatmap scale */
+  gint frame_width;
+  gint frame_height;
+
   
   /** Current batch number of the input batch. */
   gulong current_batch_num;
 
-  /** GstFlowReturn returned by the latest buffer pad push. */
-  GstFlowReturn last_flow_ret;
-
   
 
   /** NVTX Domain. */
@@ -0,0 +1,346 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include <vector>
+#include "gstnvdspostprocess_tracer.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_nvdspostprocess_tracer_debug);
+#define GST_CAT_DEFAULT gst_nvdspostprocess_tracer_debug
+
+/** factory name of the traced element */
+#define NVDSPOSTPROCESS_FACTORY "nvdspostprocess"
+
+#define gst_nvdspostprocess_tracer_parent_class parent_class
+G_DEFINE_TYPE (GstNvDsPostProcessTracer, gst_nvdspostprocess_tracer,
+    GST_TYPE_TRACER);
+
+static GstTracerRecord *tr_batch;
+static GstTracerRecord *tr_queue;
+static GstTracerRecord *tr_summary;
+
+/* Push into an nvdspostprocess sink pad in progress on this thread. The
+ * element's own push downstream happens nested inside it unless the output
+ * goes through another thread. */
+typedef struct
+{
+  GstElement *element;
+  GstClockTime entered;
+  GstClockTime downstream_start;
+  guint64 downstream_ns;
+  /** the upstream push this frame belongs to */
+  GstPad *upstream_pad;
+} GstNvDsPostProcessTracerFrame;
+
+static thread_local std::vector<GstNvDsPostProcessTracerFrame> tracer_frames;
+
+/* Pushes out of an nvdspostprocess src pad made outside of a sink push,
+ * from the output thread. */
+typedef struct
+{
+  GstElement *element;
+  GstClockTime start;
+} GstNvDsPostProcessTracerAsyncPush;
+
+static thread_local std::vector<GstNvDsPostProcessTracerAsyncPush> tracer_async;
+
+static gboolean
+is_nvdspostprocess (GstElement * element)
+{
+  GstElementFactory *factory;
+
+  if (!element || !GST_IS_ELEMENT (element))
+    return FALSE;
+  factory = gst_element_get_factory (element);
+  return factory &&
+      !strcmp (GST_OBJECT_NAME (factory), NVDSPOSTPROCESS_FACTORY);
+}
+
+/* Element owning the pad, without taking a reference. Only direct children
+ * are traced, ghost pads are not followed. */
+static GstElement *
+pad_element (GstPad * pad)
+{
+  GstObject *parent = pad ? GST_OBJECT_PARENT (pad) : NULL;
+
+  return parent && GST_IS_ELEMENT (parent) ? GST_ELEMENT_CAST (parent) : NULL;
+}
+
+static GstNvDsPostProcessTracerElement *
+tracer_element (GstNvDsPostProcessTracer * self, GstElement * element)
+{
+  GstNvDsPostProcessTracerElement *stats = (GstNvDsPostProcessTracerElement *)
+      g_hash_table_lookup (self->elements, element);
+
+  if (!stats) {
+    stats = g_new0 (GstNvDsPostProcessTracerElement, 1);
+    stats->element = element;
+    stats->name = g_strdup (GST_ELEMENT_NAME (element));
+    g_hash_table_insert (self->elements, element, stats);
+  }
+  return stats;
+}
+
+static void
+do_push_buffer_pre (GstNvDsPostProcessTracer * self, GstClockTime ts,
+    GstPad * pad, GstBuffer * buffer)
+{
+  GstElement *element = pad_element (pad);
+  GstElement *peer_element = pad_element (GST_PAD_PEER (pad));
+
+  /* Our own push downstream. */
+  if (is_nvdspostprocess (element)) {
+    if (!tracer_frames.empty () && tracer_frames.back ().element == element) {
+      tracer_frames.back ().downstream_start = ts;
+    } else {
+      GstNvDsPostProcessTracerElement *stats;
+      GstClockTime pts = GST_BUFFER_PTS (buffer);
+
+      tracer_async.push_back ({element, ts});
+
+      /* Output thread: the buffer waited since it was received. */
+      g_mutex_lock (&self->lock);
+      stats = tracer_element (self, element);
+      for (guint i = 0; i < NVDSPOSTPROCESS_TRACER_PENDING; i++) {
+        GstNvDsPostProcessTracerPending *p = &stats->pending[i];
+        if (p->pts == pts && GST_CLOCK_TIME_IS_VALID (p->received)) {
+          guint64 queue_ns = ts - p->received;
+          stats->queued++;
+          stats->queue_ns += queue_ns;
+          stats->queue_max_ns = MAX (stats->queue_max_ns, queue_ns);
+          p->received = GST_CLOCK_TIME_NONE;
+          g_mutex_unlock (&self->lock);
+          gst_tracer_record_log (tr_queue, GST_ELEMENT_NAME (element),
+              queue_ns, ts);
+          return;
+        }
+      }
+      g_mutex_unlock (&self->lock);
+    }
+    return;
+  }
+
+  /* Upstream pushing into us, submit_input_buffer runs until the post. */
+  if (is_nvdspostprocess (peer_element)) {
+    GstNvDsPostProcessTracerElement *stats;
+
+    tracer_frames.push_back ({peer_element, ts, GST_CLOCK_TIME_NONE, 0, pad});
+
+    g_mutex_lock (&self->lock);
+    stats = tracer_element (self, peer_element);
+    stats->pending[stats->pending_next].pts = GST_BUFFER_PTS (buffer);
+    stats->pending[stats->pending_next].received = ts;
+    stats->pending_next = (stats->pending_next + 1) %
+        NVDSPOSTPROCESS_TRACER_PENDING;
+    g_mutex_unlock (&self->lock);
+  }
+}
+
+static void
+do_push_buffer_post (GstNvDsPostProcessTracer * self, GstClockTime ts,
+    GstPad * pad, GstFlowReturn res)
+{
+  GstElement *element = pad_element (pad);
+
+  if (is_nvdspostprocess (element)) {
+    if (!tracer_frames.empty () && tracer_frames.back ().element == element &&
+        GST_CLOCK_TIME_IS_VALID (tracer_frames.back ().downstream_start)) {
+      GstNvDsPostProcessTracerFrame &frame = tracer_frames.back ();
+      frame.downstream_ns += ts - frame.downstream_start;
+      frame.downstream_start = GST_CLOCK_TIME_NONE;
+    } else if (!tracer_async.empty () &&
+        tracer_async.back ().element == element) {
+      guint64 downstream_ns = ts - tracer_async.back ().start;
+      GstNvDsPostProcessTracerElement *stats;
+
+      tracer_async.pop_back ();
+      g_mutex_lock (&self->lock);
+      stats = tracer_element (self, element);
+      stats->downstream_ns += downstream_ns;
+      stats->downstream_max_ns = MAX (stats->downstream_max_ns, downstream_ns);
+      g_mutex_unlock (&self->lock);
+    }
+    return;
+  }
+
+  if (!tracer_frames.empty () && tracer_frames.back ().upstream_pad == pad) {
+    GstNvDsPostProcessTracerFrame frame = tracer_frames.back ();
+    guint64 self_ns = ts - frame.entered - frame.downstream_ns;
+    GstNvDsPostProcessTracerElement *stats;
+
+    tracer_frames.pop_back ();
+
+    g_mutex_lock (&self->lock);
+    stats = tracer_element (self, frame.element);
+    stats->batches++;
+    stats->self_ns += self_ns;
+    stats->self_max_ns = MAX (stats->self_max_ns, self_ns);
+    stats->downstream_ns += frame.downstream_ns;
+    stats->downstream_max_ns =
+        MAX (stats->downstream_max_ns, frame.downstream_ns);
+    g_mutex_unlock (&self->lock);
+
+    gst_tracer_record_log (tr_batch, GST_ELEMENT_NAME (frame.element),
+        self_ns, frame.downstream_ns, ts);
+  }
+}
+
+static void
+free_element_stats (gpointer data)
+{
+  GstNvDsPostProcessTracerElement *stats =
+      (GstNvDsPostProcessTracerElement *) data;
+
+  g_free (stats->name);
+  g_free (stats);
+}
+
+static void
+log_summary (gpointer key, gpointer value, gpointer user_data)
+{
+  GstNvDsPostProcessTracerElement *stats =
+      (GstNvDsPostProcessTracerElement *) value;
+  guint64 batches = MAX (stats->batches, 1);
+
+  GST_INFO ("%s: %lu batches, self %lu ns avg %lu ns max, downstream %lu ns "
+      "avg %lu ns max, %lu queued %lu ns avg %lu ns max", stats->name,
+      (gulong) stats->batches, (gulong) (stats->self_ns / batches),
+      (gulong) stats->self_max_ns, (gulong) (stats->downstream_ns / batches),
+      (gulong) stats->downstream_max_ns, (gulong) stats->queued,
+      (gulong) (stats->queue_ns / MAX (stats->queued, 1)),
+      (gulong) stats->queue_max_ns);
+  gst_tracer_record_log (tr_summary, stats->name, stats->batches, stats->self_ns,
+      stats->self_max_ns, stats->downstream_ns, stats->downstream_max_ns,
+      stats->queued, stats->queue_ns, stats->queue_max_ns);
+}
+
+static void
+gst_nvdspostprocess_tracer_finalize (GObject * object)
+{
+  GstNvDsPostProcessTracer *self = GST_NVDSPOSTPROCESS_TRACER (object);
+
+  g_hash_table_foreach (self->elements, log_summary, NULL);
+  g_hash_table_destroy (self->elements);
+  g_mutex_clear (&self->lock);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+/* Field description of a tracer record value. */
+static GstStructure *
+record_value (GType type, const gchar * description)
+{
+  return gst_structure_new ("value",
+      "type", G_TYPE_GTYPE, type,
+      "description", G_TYPE_STRING, description,
+      "flags", GST_TYPE_TRACER_VALUE_FLAGS, GST_TRACER_VALUE_FLAGS_NONE,
+      NULL);
+}
+
+static void
+gst_nvdspostprocess_tracer_class_init (GstNvDsPostProcessTracerClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->finalize = gst_nvdspostprocess_tracer_finalize;
+
+  tr_batch = gst_tracer_record_new ("nvdspostprocess-batch.class",
+      "element", GST_TYPE_STRUCTURE, gst_structure_new ("scope",
+          "type", G_TYPE_GTYPE, G_TYPE_STRING,
+          "related-to", GST_TYPE_TRACER_VALUE_SCOPE,
+          GST_TRACER_VALUE_SCOPE_ELEMENT, NULL),
+      "self", GST_TYPE_STRUCTURE, record_value (G_TYPE_UINT64,
+          "ns spent in submit_input_buffer, downstream push excluded"),
+      "downstream", GST_TYPE_STRUCTURE, record_value (G_TYPE_UINT64,
+          "ns blocked in the downstream gst_pad_push"),
+      "ts", GST_TYPE_STRUCTURE, record_value (G_TYPE_UINT64,
+          "ts when the batch was done"),
+      NULL);
+  GST_OBJECT_FLAG_SET (tr_batch, GST_OBJECT_FLAG_MAY_BE_LEAKED);
+
+  tr_queue = gst_tracer_record_new ("nvdspostprocess-queue.class",
+      "element", GST_TYPE_STRUCTURE, gst_structure_new ("scope",
+          "type", G_TYPE_GTYPE, G_TYPE_STRING,
+          "related-to", GST_TYPE_TRACER_VALUE_SCOPE,
+          GST_TRACER_VALUE_SCOPE_ELEMENT, NULL),
+      "delay", GST_TYPE_STRUCTURE, record_value (G_TYPE_UINT64,
+          "ns from reception to the push of the output thread"),
+      "ts", GST_TYPE_STRUCTURE, record_value (G_TYPE_UINT64,
+          "ts of the push"),
+      NULL);
+  GST_OBJECT_FLAG_SET (tr_queue, GST_OBJECT_FLAG_MAY_BE_LEAKED);
+
+  tr_summary = gst_tracer_record_new ("nvdspostprocess-summary.class",
+      "element", GST_TYPE_STRUCTURE, gst_structure_new ("scope",
+          "type", G_TYPE_GTYPE, G_TYPE_STRING,
+          "related-to", GST_TYPE_TRACER_VALUE_SCOPE,
+          GST_TRACER_VALUE_SCOPE_ELEMENT, NULL),
+      "batches", GST_TYPE_STRUCTURE, record_value (G_TYPE_UINT64,
+          "batches processed"),
+      "self", GST_TYPE_STRUCTURE, record_value (G_TYPE_UINT64,
+          "total ns in submit_input_buffer"),
+      "self-max", GST_TYPE_STRUCTURE, record_value (G_TYPE_UINT64,
+          "longest batch in ns"),
+      "downstream", GST_TYPE_STRUCTURE, record_value (G_TYPE_UINT64,
+          "total ns blocked downstream"),
+      "downstream-max", GST_TYPE_STRUCTURE, record_value (G_TYPE_UINT64,
+          "longest downstream push in ns"),
+      "queued", GST_TYPE_STRUCTURE, record_value (G_TYPE_UINT64,
+          "buffers pushed by the output thread"),
+      "queue", GST_TYPE_STRUCTURE, record_value (G_TYPE_UINT64,
+          "total queueing delay in ns"),
+      "queue-max", GST_TYPE_STRUCTURE, record_value (G_TYPE_UINT64,
+          "longest queueing delay in ns"),
+      NULL);
+  GST_OBJECT_FLAG_SET (tr_summary, GST_OBJECT_FLAG_MAY_BE_LEAKED);
+}
+
+static void
+gst_nvdspostprocess_tracer_init (GstNvDsPostProcessTracer * self)
+{
+  GstTracer *tracer = GST_TRACER (self);
+
+  g_mutex_init (&self->lock);
+  self->elements = g_hash_table_new_full (NULL, NULL, NULL,
+      free_element_stats);
+
+  gst_tracing_register_hook (tracer, "pad-push-pre",
+      G_CALLBACK (do_push_buffer_pre));
+  gst_tracing_register_hook (tracer, "pad-push-post",
+      G_CALLBACK (do_push_buffer_post));
+}
+
+static gboolean
+nvdspostprocess_tracer_plugin_init (GstPlugin * plugin)
+{
+  GST_DEBUG_CATEGORY_INIT (gst_nvdspostprocess_tracer_debug,
+      "nvdspostprocesstracer", 0, "nvdspostprocess hot path tracer");
+
+  return gst_tracer_register (plugin, "nvdspostprocessprof",
+      GST_TYPE_NVDSPOSTPROCESS_TRACER);
+}
+
+GST_PLUGIN_DEFINE (GST_VERSION_MAJOR,
+    GST_VERSION_MINOR,
+    nvdsgst_postprocess_tracer,
+    DESCRIPTION, nvdspostprocess_tracer_plugin_init, "6.0", LICENSE,
+    BINARY_PACKAGE, URL)
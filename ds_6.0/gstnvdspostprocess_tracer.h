@@ -0,0 +1,101 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GST_NVDSPOSTPROCESS_TRACER_H__
+#define __GST_NVDSPOSTPROCESS_TRACER_H__
+
+#include <gst/gst.h>
+
+#define PACKAGE "nvdspostprocesstracer"
+#define VERSION "1.0"
+#define LICENSE "Proprietary"
+#define DESCRIPTION "Hot path profiling of nvdspostprocess elements"
+#define BINARY_PACKAGE "NVIDIA DeepStream postprocess tracer"
+#define URL "http://nvidia.com/"
+
+G_BEGIN_DECLS
+
+typedef struct _GstNvDsPostProcessTracer GstNvDsPostProcessTracer;
+typedef struct _GstNvDsPostProcessTracerClass GstNvDsPostProcessTracerClass;
+
+#define GST_TYPE_NVDSPOSTPROCESS_TRACER (gst_nvdspostprocess_tracer_get_type())
+#define GST_NVDSPOSTPROCESS_TRACER(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_NVDSPOSTPROCESS_TRACER,GstNvDsPostProcessTracer))
+#define GST_NVDSPOSTPROCESS_TRACER_CLASS(klass) (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_NVDSPOSTPROCESS_TRACER,GstNvDsPostProcessTracerClass))
+#define GST_IS_NVDSPOSTPROCESS_TRACER(obj) (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_NVDSPOSTPROCESS_TRACER))
+
+/** buffers kept per element to measure the queueing delay of async output */
+#define NVDSPOSTPROCESS_TRACER_PENDING 64
+
+/** input buffer waiting for the output thread */
+typedef struct
+{
+  GstClockTime pts;
+  GstClockTime received;
+} GstNvDsPostProcessTracerPending;
+
+/** totals of one nvdspostprocess instance */
+typedef struct
+{
+  GstElement *element;
+  /** copied, the summary is logged after the pipeline is gone */
+  gchar *name;
+  guint64 batches;
+  /** time in submit_input_buffer, downstream push excluded */
+  guint64 self_ns;
+  guint64 self_max_ns;
+  /** time blocked in the downstream gst_pad_push */
+  guint64 downstream_ns;
+  guint64 downstream_max_ns;
+  /** reception to output push of buffers pushed from another thread */
+  guint64 queued;
+  guint64 queue_ns;
+  guint64 queue_max_ns;
+  /** ring of recently received buffers */
+  GstNvDsPostProcessTracerPending pending[NVDSPOSTPROCESS_TRACER_PENDING];
+  guint pending_next;
+} GstNvDsPostProcessTracerElement;
+
+/**
+ * Tracer attributing the time of every nvdspostprocess instance to its own
+ * processing and to the downstream push, loaded with
+ * GST_TRACERS="nvdspostprocessprof".
+ */
+struct _GstNvDsPostProcessTracer
+{
+  GstTracer parent;
+
+  /** protects elements */
+  GMutex lock;
+
+  /** GstNvDsPostProcessTracerElement of every instance seen */
+  GHashTable *elements;
+};
+
+struct _GstNvDsPostProcessTracerClass
+{
+  GstTracerClass parent_class;
+};
+
+GType gst_nvdspostprocess_tracer_get_type (void);
+
+G_END_DECLS
+#endif /* __GST_NVDSPOSTPROCESS_TRACER_H__ */
@@ -0,0 +1,570 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <math.h>
+#include <algorithm>
+#include "nvdspostprocess_analytics.h"
+
+static inline size_t
+analytics_track_hash (uint64_t object_id, size_t mask)
+{
+  /* Fibonacci hashing, tracker ids are often sequential. */
+  return (size_t) ((object_id * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+}
+
+/* Insert a track known to be absent, the table has a free slot. */
+static inline AnalyticsTrack *
+analytics_track_insert (std::vector<AnalyticsTrack> &slots,
+    const AnalyticsTrack &track)
+{
+  size_t mask = slots.size () - 1;
+  size_t i = analytics_track_hash (track.object_id, mask);
+
+  while (slots[i].object_id != ANALYTICS_UNTRACKED_ID)
+    i = (i + 1) & mask;
+  slots[i] = track;
+  return &slots[i];
+}
+
+/* Move the live tracks into the scratch slots and swap them in. */
+static void
+analytics_track_rehash (AnalyticsTrackTable *table, size_t size,
+    uint64_t min_frame)
+{
+  table->scratch.assign (size, {ANALYTICS_UNTRACKED_ID, 0, 0, 0, 0, 0, 0, 0, 0});
+  table->count = 0;
+  for (const AnalyticsTrack &track : table->slots) {
+    if (track.object_id != ANALYTICS_UNTRACKED_ID &&
+        track.last_frame >= min_frame) {
+      analytics_track_insert (table->scratch, track);
+      table->count++;
+    }
+  }
+  table->slots.swap (table->scratch);
+  table->scratch.resize (size);
+}
+
+AnalyticsTrack *
+analytics_track_lookup (AnalyticsTrackTable *table, uint64_t object_id)
+{
+  size_t mask, i;
+
+  if (table->slots.empty ()) {
+    table->slots.assign (ANALYTICS_TRACK_TABLE_MIN_SIZE,
+        {ANALYTICS_UNTRACKED_ID, 0, 0, 0, 0, 0, 0, 0, 0});
+    table->scratch.resize (ANALYTICS_TRACK_TABLE_MIN_SIZE);
+    table->count = 0;
+  }
+
+  mask = table->slots.size () - 1;
+  for (i = analytics_track_hash (object_id, mask);
+      table->slots[i].object_id != ANALYTICS_UNTRACKED_ID;
+      i = (i + 1) & mask) {
+    if (table->slots[i].object_id == object_id)
+      return &table->slots[i];
+  }
+
+  /* Keep the load under 1/2 so that probes stay short. */
+  if (2 * (table->count + 1) > table->slots.size ()) {
+    analytics_track_rehash (table, 2 * table->slots.size (), 0);
+    return analytics_track_lookup (table, object_id);
+  }
+
+  table->count++;
+  table->slots[i] = {object_id, 0, 0, 0, 0, 0, 0, 0, 0};
+  return &table->slots[i];
+}
+
+const AnalyticsTrack *
+analytics_track_find (const AnalyticsTrackTable *table, uint64_t object_id)
+{
+  size_t mask, i;
+
+  if (table->slots.empty () || object_id == ANALYTICS_UNTRACKED_ID)
+    return NULL;
+
+  mask = table->slots.size () - 1;
+  for (i = analytics_track_hash (object_id, mask);
+      table->slots[i].object_id != ANALYTICS_UNTRACKED_ID;
+      i = (i + 1) & mask) {
+    if (table->slots[i].object_id == object_id)
+      return &table->slots[i];
+  }
+  return NULL;
+}
+
+void
+analytics_track_sweep (AnalyticsTrackTable *table, uint64_t min_frame)
+{
+  if (table->count)
+    analytics_track_rehash (table, table->slots.size (), min_frame);
+}
+
+size_t
+analytics_zone_set_init (AnalyticsZoneSet *set,
+    const std::vector<AnalyticsZone> &zones)
+{
+  size_t num_zones = std::min (zones.size (), (size_t) ANALYTICS_MAX_ZONES);
+
+  set->zones.assign (zones.begin (), zones.begin () + num_zones);
+  set->anchors.assign (num_zones, {ANALYTICS_ANCHOR_BOTTOM_CENTRE, 1.0});
+  set->bounds.clear ();
+  for (const AnalyticsZone &zone : set->zones) {
+    AnalyticsZoneBounds bounds = {0, 0, 0, 0, 0};
+    double area = 0;
+
+    if (!zone.empty ()) {
+      bounds = {zone[0].x, zone[0].y, zone[0].x, zone[0].y, 0};
+      for (size_t i = 0, j = zone.size () - 1; i < zone.size (); j = i++) {
+        bounds.left = std::min (bounds.left, zone[i].x);
+        bounds.top = std::min (bounds.top, zone[i].y);
+        bounds.right = std::max (bounds.right, zone[i].x);
+        bounds.bottom = std::max (bounds.bottom, zone[i].y);
+        area += zone[j].x * zone[i].y - zone[i].x * zone[j].y;
+      }
+    }
+    bounds.area = std::fabs (area) / 2;
+    set->bounds.push_back (bounds);
+  }
+  set->coverage_cells.clear ();
+  set->coverage_area.assign (num_zones, 0);
+  return num_zones;
+}
+
+void
+analytics_zone_set_anchor (AnalyticsZoneSet *set, size_t zone,
+    const AnalyticsZoneAnchor &anchor)
+{
+  if (zone < set->anchors.size ())
+    set->anchors[zone] = anchor;
+}
+
+void
+analytics_source_init (AnalyticsSource *src, const AnalyticsZoneSet *zone_set)
+{
+  size_t num_zones = zone_set->zones.size ();
+
+  src->zone_set = zone_set;
+  src->occupancy.assign (num_zones, 0);
+  src->entries.assign (num_zones, 0);
+  src->coverage.assign (num_zones, 0);
+  src->tracks.slots.clear ();
+  src->tracks.scratch.clear ();
+  src->tracks.count = 0;
+  src->frames_processed = 0;
+  src->last_analysed_frame = 0;
+}
+
+bool
+analytics_point_in_zone (const AnalyticsZone &zone, double x, double y)
+{
+  bool inside = false;
+  size_t n = zone.size ();
+
+  for (size_t i = 0, j = n - 1; i < n; j = i++) {
+    double xi = zone[i].x, yi = zone[i].y;
+    double xj = zone[j].x, yj = zone[j].y;
+    if (((yi > y) != (yj > y)) &&
+        (x < (xj - xi) * (y - yi) / (yj - yi) + xi))
+      inside = !inside;
+  }
+  return inside;
+}
+
+/* Keep the part of @in on one side of an axis-aligned line: coordinate
+ * AXIS (0 for x, 1 for y) >= @bound if KEEP_ABOVE, <= @bound otherwise. */
+template <int AXIS, bool KEEP_ABOVE>
+static void
+analytics_clip_side (const std::vector<AnalyticsPoint> &in, double bound,
+    std::vector<AnalyticsPoint> *out)
+{
+  auto coord = [] (const AnalyticsPoint &p) { return AXIS ? p.y : p.x; };
+  auto keep = [bound] (double v) { return KEEP_ABOVE ? v >= bound : v <= bound; };
+
+  out->clear ();
+  if (in.empty ())
+    return;
+
+  AnalyticsPoint prev = in.back ();
+  bool prev_in = keep (coord (prev));
+  for (const AnalyticsPoint &cur : in) {
+    bool cur_in = keep (coord (cur));
+    if (cur_in != prev_in) {
+      double t = (bound - coord (prev)) / (coord (cur) - coord (prev));
+      if (AXIS)
+        out->push_back ({prev.x + t * (cur.x - prev.x), bound});
+      else
+        out->push_back ({bound, prev.y + t * (cur.y - prev.y)});
+    }
+    if (cur_in)
+      out->push_back (cur);
+    prev = cur;
+    prev_in = cur_in;
+  }
+}
+
+double
+analytics_zone_box_area (const AnalyticsZone &zone, double left, double top,
+    double right, double bottom, std::vector<AnalyticsPoint> clip[2])
+{
+  double area = 0;
+
+  analytics_clip_side<0, true> (zone, left, &clip[0]);
+  analytics_clip_side<0, false> (clip[0], right, &clip[1]);
+  analytics_clip_side<1, true> (clip[1], top, &clip[0]);
+  analytics_clip_side<1, false> (clip[0], bottom, &clip[1]);
+
+  const std::vector<AnalyticsPoint> &poly = clip[1];
+  for (size_t i = 0, j = poly.size () - 1; i < poly.size (); j = i++)
+    area += poly[j].x * poly[i].y - poly[i].x * poly[j].y;
+  return std::fabs (area) / 2;
+}
+
+/* Box of @width x @height with the bottom centre at (@x, @y) against zone
+ * @z with the zone's anchor. */
+static bool
+analytics_box_in_zone (AnalyticsSource *src, size_t z, double x, double y,
+    double width, double height)
+{
+  const AnalyticsZoneSet *set = src->zone_set;
+  const AnalyticsZoneAnchor &anchor = set->anchors[z];
+  const AnalyticsZoneBounds &bounds = set->bounds[z];
+  double left = x - width / 2, top = y - height;
+
+  switch (anchor.mode) {
+    case ANALYTICS_ANCHOR_CENTROID:
+      return analytics_point_in_zone (set->zones[z], x, y - height / 2);
+    case ANALYTICS_ANCHOR_OVERLAP:
+      if (width <= 0 || height <= 0 || left >= bounds.right ||
+          x + width / 2 <= bounds.left || top >= bounds.bottom ||
+          y <= bounds.top)
+        return false;
+      return analytics_zone_box_area (set->zones[z], left, top,
+          x + width / 2, y, src->clip) >= anchor.min_overlap * width * height;
+    default:
+      return analytics_point_in_zone (set->zones[z], x, y);
+  }
+}
+
+/* Even-odd test of @n points against a zone, edge by edge over all the
+ * points. Same arithmetic as analytics_point_in_zone, without branches. */
+static void
+analytics_points_in_zone (const AnalyticsZone &zone, const double *x,
+    const double *y, size_t n, uint8_t *inside)
+{
+  std::fill (inside, inside + n, 0);
+  for (size_t i = 0, j = zone.size () - 1; i < zone.size (); j = i++) {
+    double xi = zone[i].x, yi = zone[i].y;
+    double xj = zone[j].x, yj = zone[j].y;
+
+    /* Horizontal edges are never crossed. */
+    if (yi == yj)
+      continue;
+    for (size_t k = 0; k < n; k++) {
+      inside[k] ^= ((yi > y[k]) != (yj > y[k])) &
+          (x[k] < (xj - xi) * (y[k] - yi) / (yj - yi) + xi);
+    }
+  }
+}
+
+/* Overlap test of the boxes of @objects against zone @z. The boxes are
+ * first tested against the zone bounds over all the objects, only those
+ * that touch them are clipped. */
+static void
+analytics_boxes_in_zone (AnalyticsSource *src, size_t z,
+    const AnalyticsObjects *objects, size_t n, uint8_t *inside)
+{
+  const AnalyticsZoneSet *set = src->zone_set;
+  const AnalyticsZoneBounds &bounds = set->bounds[z];
+  double min_overlap = set->anchors[z].min_overlap;
+
+  for (size_t k = 0; k < n; k++) {
+    float right = objects->left[k] + objects->width[k];
+    float bottom = objects->top[k] + objects->height[k];
+    inside[k] = (objects->counted[k] != 0) & (objects->width[k] > 0) &
+        (objects->height[k] > 0) & (objects->left[k] < bounds.right) &
+        (right > bounds.left) & (objects->top[k] < bounds.bottom) &
+        (bottom > bounds.top);
+  }
+
+  for (size_t k = 0; k < n; k++) {
+    if (!inside[k])
+      continue;
+    double left = objects->left[k], top = objects->top[k];
+    double right = left + objects->width[k];
+    double bottom = top + objects->height[k];
+    double box_area = (double) objects->width[k] * objects->height[k];
+    double area;
+
+    /* A box around the whole zone needs no clipping. */
+    if (left <= bounds.left && right >= bounds.right && top <= bounds.top &&
+        bottom >= bounds.bottom)
+      area = bounds.area;
+    else
+      area = analytics_zone_box_area (set->zones[z], left, top, right, bottom,
+          src->clip);
+    inside[k] = area >= min_overlap * box_area;
+  }
+}
+
+void
+analytics_zone_set_coverage (AnalyticsZoneSet *set, size_t zone, bool enable)
+{
+  if (zone >= set->zones.size ())
+    return;
+  const AnalyticsZoneBounds &bounds = set->bounds[zone];
+  double cell_width = (bounds.right - bounds.left) / ANALYTICS_COVERAGE_CELLS;
+  double cell_height = (bounds.bottom - bounds.top) / ANALYTICS_COVERAGE_CELLS;
+  double x[ANALYTICS_COVERAGE_CELLS], y[ANALYTICS_COVERAGE_CELLS];
+  uint8_t inside[ANALYTICS_COVERAGE_CELLS];
+  uint32_t area = 0;
+
+  set->coverage_area[zone] = 0;
+  if (!enable || cell_width <= 0 || cell_height <= 0)
+    return;
+
+  set->coverage_cells.resize (set->zones.size () * ANALYTICS_COVERAGE_CELLS);
+  uint64_t *cells = &set->coverage_cells[zone * ANALYTICS_COVERAGE_CELLS];
+  for (size_t c = 0; c < ANALYTICS_COVERAGE_CELLS; c++)
+    x[c] = bounds.left + (c + 0.5) * cell_width;
+  for (size_t r = 0; r < ANALYTICS_COVERAGE_CELLS; r++) {
+    std::fill (y, y + ANALYTICS_COVERAGE_CELLS,
+        bounds.top + (r + 0.5) * cell_height);
+    analytics_points_in_zone (set->zones[zone], x, y,
+        ANALYTICS_COVERAGE_CELLS, inside);
+    cells[r] = 0;
+    for (size_t c = 0; c < ANALYTICS_COVERAGE_CELLS; c++)
+      cells[r] |= (uint64_t) inside[c] << c;
+    area += __builtin_popcountll (cells[r]);
+  }
+  set->coverage_area[zone] = area;
+}
+
+/* First and last cells of the coverage grid whose centre is in
+ * [@from, @to) along an axis starting at @origin, last < first when none. */
+static inline void
+analytics_cell_span (double from, double to, double origin, double cell,
+    long *first, long *last)
+{
+  *first = std::max (0L, (long) ceil ((from - origin) / cell - 0.5));
+  *last = std::min ((long) ANALYTICS_COVERAGE_CELLS - 1,
+      (long) ceil ((to - origin) / cell - 0.5) - 1);
+}
+
+/* Fraction of the cells of zone @z covered by the counted boxes. Each box
+ * sets a span of bits in the rows it covers, so a box costs at most one
+ * word OR per row whatever its size, and the union is clipped to the zone
+ * by ANDing the rows with the zone cells. */
+static float
+analytics_zone_coverage (const AnalyticsSource *src, size_t z,
+    const AnalyticsObjects *objects, size_t n)
+{
+  const AnalyticsZoneSet *set = src->zone_set;
+  const AnalyticsZoneBounds &bounds = set->bounds[z];
+  const uint64_t *cells = &set->coverage_cells[z * ANALYTICS_COVERAGE_CELLS];
+  double cell_width = (bounds.right - bounds.left) / ANALYTICS_COVERAGE_CELLS;
+  double cell_height = (bounds.bottom - bounds.top) / ANALYTICS_COVERAGE_CELLS;
+  uint64_t rows[ANALYTICS_COVERAGE_CELLS] = {0};
+  uint32_t covered = 0;
+
+  for (size_t k = 0; k < n; k++) {
+    long c0, c1, r0, r1;
+
+    if (!objects->counted[k])
+      continue;
+    analytics_cell_span (objects->left[k],
+        (double) objects->left[k] + objects->width[k], bounds.left,
+        cell_width, &c0, &c1);
+    analytics_cell_span (objects->top[k],
+        (double) objects->top[k] + objects->height[k], bounds.top,
+        cell_height, &r0, &r1);
+    if (c0 > c1 || r0 > r1)
+      continue;
+
+    uint64_t span = (~(uint64_t) 0 >> (63 - c1)) & (~(uint64_t) 0 << c0);
+    for (long r = r0; r <= r1; r++)
+      rows[r] |= span;
+  }
+
+  for (size_t r = 0; r < ANALYTICS_COVERAGE_CELLS; r++)
+    covered += __builtin_popcountll (rows[r] & cells[r]);
+  return (float) covered / set->coverage_area[z];
+}
+
+uint64_t
+analytics_test_zones (AnalyticsSource *src, const AnalyticsObjects *objects,
+    size_t num_objects)
+{
+  const AnalyticsZoneSet *set = src->zone_set;
+  size_t num_zones = set->zones.size ();
+  uint64_t counted = 0;
+  AnalyticsAnchorMode point_mode = ANALYTICS_ANCHOR_COUNT;
+
+  if (src->inside.size () < num_objects) {
+    src->anchor_x.resize (num_objects);
+    src->anchor_y.resize (num_objects);
+    src->inside.resize (num_objects);
+  }
+  double *x = src->anchor_x.data (), *y = src->anchor_y.data ();
+  uint8_t *inside = src->inside.data ();
+
+  std::fill (src->occupancy.begin (), src->occupancy.end (), 0);
+  std::fill (objects->zone_mask, objects->zone_mask + num_objects, 0);
+  for (size_t z = 0; z < num_zones; z++) {
+    AnalyticsAnchorMode mode = set->anchors[z].mode;
+    uint64_t bit = (uint64_t) 1 << z;
+    uint32_t occupancy = 0;
+
+    if (mode == ANALYTICS_ANCHOR_OVERLAP) {
+      analytics_boxes_in_zone (src, z, objects, num_objects, inside);
+    } else {
+      /* The anchors are shared by the zones of the same mode. */
+      if (mode != point_mode) {
+        for (size_t k = 0; k < num_objects; k++) {
+          x[k] = objects->left[k] + objects->width[k] / 2;
+          y[k] = mode == ANALYTICS_ANCHOR_CENTROID ?
+              objects->top[k] + objects->height[k] / 2 :
+              objects->top[k] + objects->height[k];
+        }
+        point_mode = mode;
+      }
+      analytics_points_in_zone (set->zones[z], x, y, num_objects, inside);
+    }
+
+    for (size_t k = 0; k < num_objects; k++) {
+      uint8_t in = inside[k] & (objects->counted[k] != 0);
+      objects->zone_mask[k] |= in ? bit : 0;
+      occupancy += in;
+    }
+    src->occupancy[z] = occupancy;
+    if (set->coverage_area[z])
+      src->coverage[z] = analytics_zone_coverage (src, z, objects, num_objects);
+  }
+
+  for (size_t k = 0; k < num_objects; k++)
+    counted += objects->zone_mask[k] != 0;
+  return counted;
+}
+
+/* Count the zones of @zone_mask the track was not in. */
+static inline uint64_t
+analytics_count_entries (AnalyticsSource *src, const AnalyticsTrack &track,
+    uint64_t zone_mask)
+{
+  uint64_t entered = zone_mask & ~track.zone_mask;
+  uint64_t events = 0;
+
+  for (size_t z = 0; entered; z++, entered >>= 1) {
+    if (entered & 1) {
+      src->entries[z]++;
+      events++;
+    }
+  }
+  return events;
+}
+
+static void
+analytics_advance_frame (AnalyticsSource *src)
+{
+  /* Forget the tracks the tracker stopped reporting. */
+  if (++src->frames_processed % ANALYTICS_TRACK_SWEEP_INTERVAL == 0 &&
+      src->frames_processed > ANALYTICS_TRACK_TIMEOUT_FRAMES) {
+    analytics_track_sweep (&src->tracks,
+        src->frames_processed - ANALYTICS_TRACK_TIMEOUT_FRAMES);
+  }
+}
+
+uint64_t
+analytics_update_tracks (AnalyticsSource *src,
+    const AnalyticsObjects *objects, size_t num_objects)
+{
+  uint64_t events = 0;
+
+  for (size_t i = 0; i < num_objects; i++) {
+    uint64_t object_id = objects->object_id[i];
+    uint64_t zone_mask = objects->zone_mask[i];
+    float x = objects->left[i] + objects->width[i] / 2;
+    float y = objects->top[i] + objects->height[i];
+    float width = objects->width[i], height = objects->height[i];
+
+    if (!objects->counted[i] || object_id == ANALYTICS_UNTRACKED_ID)
+      continue;
+
+    /* The table only counts up when the track is inserted. */
+    size_t count = src->tracks.count;
+    AnalyticsTrack &track = *analytics_track_lookup (&src->tracks, object_id);
+    if (src->tracks.count == count &&
+        src->frames_processed > track.last_frame) {
+      float dt = src->frames_processed - track.last_frame;
+      track.vx = (x - track.x) / dt;
+      track.vy = (y - track.y) / dt;
+    }
+    events += analytics_count_entries (src, track, zone_mask);
+    track.zone_mask = zone_mask;
+    track.last_frame = src->frames_processed;
+    track.x = x;
+    track.y = y;
+    track.width = width;
+    track.height = height;
+  }
+
+  src->last_analysed_frame = src->frames_processed;
+  analytics_advance_frame (src);
+  return events;
+}
+
+uint64_t
+analytics_extrapolate_frame (AnalyticsSource *src)
+{
+  size_t num_zones = src->zone_set->zones.size ();
+  uint64_t events = 0;
+
+  for (AnalyticsTrack &track : src->tracks.slots) {
+    if (track.object_id == ANALYTICS_UNTRACKED_ID ||
+        track.last_frame != src->last_analysed_frame)
+      continue;
+
+    float dt = src->frames_processed - track.last_frame;
+    double x = track.x + track.vx * dt;
+    double y = track.y + track.vy * dt;
+    uint64_t zone_mask = 0;
+
+    for (size_t z = 0; z < num_zones; z++) {
+      if (analytics_box_in_zone (src, z, x, y, track.width, track.height))
+        zone_mask |= (uint64_t) 1 << z;
+    }
+    events += analytics_count_entries (src, track, zone_mask);
+    track.zone_mask |= zone_mask;
+  }
+
+  analytics_advance_frame (src);
+  return events;
+}
+
+void
+analytics_process_frame (AnalyticsSource *src, const AnalyticsObjects *objects,
+    size_t num_objects, AnalyticsFrameResult *result)
+{
+  result->counted = analytics_test_zones (src, objects, num_objects);
+  result->events = analytics_update_tracks (src, objects, num_objects);
+}
@@ -0,0 +1,308 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef __NVDSPOSTPROCESS_ANALYTICS_H__
+#define __NVDSPOSTPROCESS_ANALYTICS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Zone counting engine: tests the object anchors against the zones of a
+ * source, keeps the zone membership of every track and counts the zone
+ * entries. Only depends on the standard library, the element feeds it with
+ * the objects of its batches.
+ *
+ * The zones are tested one at a time over all the objects of a frame, edge
+ * by edge, so that the inner loops run over contiguous columns without
+ * branches and the compiler can vectorize them.
+ */
+
+/** zones per source, bounded by the width of the zone masks */
+#define ANALYTICS_MAX_ZONES 64
+
+/** object_id of objects no tracker reported */
+#define ANALYTICS_UNTRACKED_ID UINT64_MAX
+
+/** frames a track may go unseen before it is forgotten */
+#define ANALYTICS_TRACK_TIMEOUT_FRAMES 300
+
+/** frames between two sweeps of the stale tracks of a source */
+#define ANALYTICS_TRACK_SWEEP_INTERVAL 64
+
+/** initial slots of a track table, a power of 2 */
+#define ANALYTICS_TRACK_TABLE_MIN_SIZE 256
+
+/** zone vertex, in pixels of the source frame */
+typedef struct
+{
+  double x, y;
+} AnalyticsPoint;
+
+/** zone polygon */
+typedef std::vector<AnalyticsPoint> AnalyticsZone;
+
+/** what of an object box has to be in a zone for the object to be in it */
+typedef enum
+{
+  /** the middle of the bottom edge, where the object stands */
+  ANALYTICS_ANCHOR_BOTTOM_CENTRE,
+  /** the centre of the box */
+  ANALYTICS_ANCHOR_CENTROID,
+  /** at least min_overlap of the box area */
+  ANALYTICS_ANCHOR_OVERLAP,
+  ANALYTICS_ANCHOR_COUNT
+} AnalyticsAnchorMode;
+
+/** membership rule of a zone */
+typedef struct
+{
+  AnalyticsAnchorMode mode;
+  /** ANALYTICS_ANCHOR_OVERLAP: fraction of the box area, in (0, 1] */
+  double min_overlap;
+} AnalyticsZoneAnchor;
+
+/** bounding box and area of a zone, for the overlap tests */
+typedef struct
+{
+  double left, top, right, bottom;
+  double area;
+} AnalyticsZoneBounds;
+
+/** rows and columns of the coverage grid laid over the bounds of a zone,
+ * a row is one 64 bit word */
+#define ANALYTICS_COVERAGE_CELLS 64
+
+/** state kept per tracked object */
+typedef struct
+{
+  /** ANALYTICS_UNTRACKED_ID marks a free slot */
+  uint64_t object_id;
+  /** bit z set when the track was inside zone z when last seen */
+  uint64_t zone_mask;
+  /** frame counter of the source when last seen */
+  uint64_t last_frame;
+  /** bottom centre and size of the box when last seen and its motion in
+   * pixels per frame, to extrapolate the track over the frames that are not
+   * analysed */
+  float x, y;
+  float vx, vy;
+  float width, height;
+} AnalyticsTrack;
+
+/**
+ * Tracks keyed by object_id, open addressing with linear probing. The slots
+ * only grow, so once the table has reached the number of live tracks of the
+ * stream, new tracks and the sweeps no longer allocate.
+ */
+typedef struct
+{
+  /** power of 2 slots, at most half of them used */
+  std::vector<AnalyticsTrack> slots;
+  /** same size as slots, the sweep rehashes the live tracks into it */
+  std::vector<AnalyticsTrack> scratch;
+  size_t count;
+} AnalyticsTrackTable;
+
+/**
+ * Objects as parallel arrays, gathered once per batch so that the stages
+ * stream through contiguous memory instead of chasing metadata lists.
+ * Entry i of every array is object i.
+ */
+typedef struct
+{
+  /** box in pixels of the source frame */
+  const float *left;
+  const float *top;
+  const float *width;
+  const float *height;
+  /** track id, ANALYTICS_UNTRACKED_ID for untracked objects */
+  const uint64_t *object_id;
+  /** non zero if the class is one of the counted classes */
+  const uint8_t *counted;
+  /** zones containing the anchor, set by analytics_test_zones */
+  uint64_t *zone_mask;
+} AnalyticsObjects;
+
+/**
+ * Zones of a source compiled for the tests. Not modified once set up, so
+ * the sources counting with the same zones can share one.
+ */
+typedef struct
+{
+  std::vector<AnalyticsZone> zones;
+  /** membership rule and bounds of each zone */
+  std::vector<AnalyticsZoneAnchor> anchors;
+  std::vector<AnalyticsZoneBounds> bounds;
+  /** coverage grid of each measured zone, ANALYTICS_COVERAGE_CELLS rows per
+   * zone with the bits of the cells whose centre is inside it, and the
+   * number of such cells, 0 for the zones whose coverage is not measured */
+  std::vector<uint64_t> coverage_cells;
+  std::vector<uint32_t> coverage_area;
+} AnalyticsZoneSet;
+
+/** counting state of one source */
+typedef struct
+{
+  /** zones counted, outlive the source */
+  const AnalyticsZoneSet *zone_set;
+  /** counted objects inside each zone in the last frame */
+  std::vector<uint32_t> occupancy;
+  /** tracks that entered each zone */
+  std::vector<uint64_t> entries;
+  /** fraction of each zone covered by counted boxes in the last frame */
+  std::vector<float> coverage;
+  /** tracks seen on this source */
+  AnalyticsTrackTable tracks;
+  /** frames processed for this source */
+  uint64_t frames_processed;
+  /** frame counter of the last frame whose objects were analysed */
+  uint64_t last_analysed_frame;
+  /** per object scratch of the zone test: anchor and zone flag */
+  std::vector<double> anchor_x;
+  std::vector<double> anchor_y;
+  std::vector<uint8_t> inside;
+  /** vertices of the clipping stages of the overlap test */
+  std::vector<AnalyticsPoint> clip[2];
+} AnalyticsSource;
+
+/** outcome of a frame */
+typedef struct
+{
+  /** counted objects inside at least one zone */
+  uint64_t counted;
+  /** zone entries */
+  uint64_t events;
+} AnalyticsFrameResult;
+
+/**
+ * Compile zone polygons. The zones use the bottom centre anchor until
+ * analytics_zone_set_anchor.
+ *
+ * @return number of zones kept, at most ANALYTICS_MAX_ZONES
+ */
+size_t analytics_zone_set_init (AnalyticsZoneSet *set,
+    const std::vector<AnalyticsZone> &zones);
+
+/** Set the membership rule of zone @zone, ignored past the last zone. */
+void analytics_zone_set_anchor (AnalyticsZoneSet *set, size_t zone,
+    const AnalyticsZoneAnchor &anchor);
+
+/**
+ * Measure the fraction of zone @zone covered by the union of the counted
+ * boxes of each frame, ignored past the last zone. The zone is rasterized
+ * once into the cells of its coverage grid, the boxes of a frame are filled
+ * into a grid of the same cells and the covered cells of the zone counted.
+ */
+void analytics_zone_set_coverage (AnalyticsZoneSet *set, size_t zone,
+    bool enable);
+
+/** Count with the zones of @zone_set and clear the counts and tracks. */
+void analytics_source_init (AnalyticsSource *src,
+    const AnalyticsZoneSet *zone_set);
+
+/**
+ * Track of @object_id, inserted with an empty zone mask if it is new.
+ * The pointer is valid until the next insertion.
+ */
+AnalyticsTrack *analytics_track_lookup (AnalyticsTrackTable *table,
+    uint64_t object_id);
+
+/** Track of @object_id, NULL if it is not tracked. */
+const AnalyticsTrack *analytics_track_find (const AnalyticsTrackTable *table,
+    uint64_t object_id);
+
+/** Remove the tracks last seen before @min_frame. */
+void analytics_track_sweep (AnalyticsTrackTable *table, uint64_t min_frame);
+
+/** Even-odd crossing test of a point against a zone polygon. */
+bool analytics_point_in_zone (const AnalyticsZone &zone, double x, double y);
+
+/**
+ * Area of the part of @zone inside an axis-aligned box: Sutherland-Hodgman
+ * clipping of the zone by the four sides of the box, which is convex, so
+ * that the zone itself may be concave. @clip holds the two vertex buffers
+ * of the stages.
+ */
+double analytics_zone_box_area (const AnalyticsZone &zone, double left,
+    double top, double right, double bottom, std::vector<AnalyticsPoint> clip[2]);
+
+/** true if @class_id is one of @class_ids, or @class_ids is empty */
+static inline bool
+analytics_is_counted_class (const std::vector<int> &class_ids, int class_id)
+{
+  if (class_ids.empty ())
+    return true;
+  for (int id : class_ids)
+    if (id == class_id)
+      return true;
+  return false;
+}
+
+/** Arrays of @objects starting at object @first. */
+static inline AnalyticsObjects
+analytics_objects_slice (const AnalyticsObjects &objects, size_t first)
+{
+  return {objects.left + first, objects.top + first, objects.width + first,
+      objects.height + first, objects.object_id + first,
+      objects.counted + first, objects.zone_mask + first};
+}
+
+/**
+ * Set the zone mask of the objects of a frame, 0 for the uncounted ones,
+ * and recount the zone occupancy and coverage. Each zone tests the objects
+ * with its own anchor.
+ *
+ * @return counted objects inside at least one zone
+ */
+uint64_t analytics_test_zones (AnalyticsSource *src,
+    const AnalyticsObjects *objects, size_t num_objects);
+
+/**
+ * Update the zone membership of the tracks seen in a frame, count their zone
+ * entries and advance the frame counter of the source.
+ *
+ * @return zone entries
+ */
+uint64_t analytics_update_tracks (AnalyticsSource *src,
+    const AnalyticsObjects *objects, size_t num_objects);
+
+/**
+ * Advance a source over a frame whose objects are not analysed. The
+ * occupancy of the last analysed frame is carried forward and the tracks
+ * seen in it are moved along their last motion; the entries of the zones
+ * they are predicted to reach are counted. Predicted entries are only added
+ * to the zone membership, the next analysed frame sets it from the real
+ * anchors.
+ *
+ * @return zone entries
+ */
+uint64_t analytics_extrapolate_frame (AnalyticsSource *src);
+
+/** analytics_test_zones followed by analytics_update_tracks. */
+void analytics_process_frame (AnalyticsSource *src,
+    const AnalyticsObjects *objects, size_t num_objects,
+    AnalyticsFrameResult *result);
+
+#endif /* __NVDSPOSTPROCESS_ANALYTICS_H__ */
@@ -0,0 +1,134 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <stdlib.h>
+#include <algorithm>
+#include "nvdspostprocess_arena.h"
+
+struct _ArenaOverflow
+{
+  ArenaOverflow *next;
+  /** keeps the data that follows 64 byte aligned */
+  uint8_t pad[64 - sizeof (ArenaOverflow *)];
+};
+
+static inline size_t
+arena_round_pow2 (size_t size)
+{
+  size_t pow2 = ARENA_MIN_SIZE;
+
+  while (pow2 < size)
+    pow2 <<= 1;
+  return pow2;
+}
+
+static bool
+arena_resize (ScratchArena *arena, size_t size)
+{
+  uint8_t *block = (uint8_t *) aligned_alloc (64, size);
+
+  if (!block)
+    return false;
+  free (arena->block);
+  arena->block = block;
+  arena->size = size;
+  return true;
+}
+
+bool
+arena_init (ScratchArena *arena, size_t size)
+{
+  arena->block = NULL;
+  arena->used = 0;
+  arena->overflow = NULL;
+  arena->overflow_bytes = 0;
+  arena->high_water = 0;
+  arena->window_batches = 0;
+  return arena_resize (arena, arena_round_pow2 (size));
+}
+
+void *
+arena_alloc (ScratchArena *arena, size_t size, size_t align)
+{
+  size_t offset = (arena->used + align - 1) & ~(align - 1);
+  ArenaOverflow *overflow;
+
+  if (offset + size <= arena->size) {
+    arena->used = offset + size;
+    return arena->block + offset;
+  }
+
+  /* Block full, this batch gets a dedicated allocation. */
+  overflow = (ArenaOverflow *) aligned_alloc (64,
+      (sizeof (ArenaOverflow) + size + 63) & ~(size_t) 63);
+  if (!overflow)
+    abort ();
+  overflow->next = arena->overflow;
+  arena->overflow = overflow;
+  arena->overflow_bytes += size + align - 1;
+  return overflow + 1;
+}
+
+size_t
+arena_reset (ScratchArena *arena)
+{
+  size_t batch = arena->used + arena->overflow_bytes;
+
+  while (arena->overflow) {
+    ArenaOverflow *next = arena->overflow->next;
+    free (arena->overflow);
+    arena->overflow = next;
+  }
+
+  arena->high_water = std::max (arena->high_water, batch);
+  if (arena->overflow_bytes) {
+    /* Grow now, the next batches are likely as large. */
+    arena_resize (arena, arena_round_pow2 (arena->high_water));
+  } else if (++arena->window_batches >= ARENA_SHRINK_WINDOW) {
+    /* Give memory back when the block is 4x what the window needed. */
+    size_t target = arena_round_pow2 (arena->high_water);
+    if (arena->size >= 4 * target)
+      arena_resize (arena, 2 * target);
+    arena->high_water = 0;
+    arena->window_batches = 0;
+  }
+
+  arena->used = 0;
+  arena->overflow_bytes = 0;
+  return batch;
+}
+
+void
+arena_free (ScratchArena *arena)
+{
+  while (arena->overflow) {
+    ArenaOverflow *next = arena->overflow->next;
+    free (arena->overflow);
+    arena->overflow = next;
+  }
+  free (arena->block);
+  arena->block = NULL;
+  arena->size = 0;
+  arena->used = 0;
+  arena->overflow_bytes = 0;
+}
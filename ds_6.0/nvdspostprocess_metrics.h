@@ -0,0 +1,63 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __NVDSPOSTPROCESS_METRICS_H__
+#define __NVDSPOSTPROCESS_METRICS_H__
+
+#include <stdint.h>
+#include <functional>
+#include <string>
+
+/**
+ * Minimal HTTP listener serving Prometheus text exposition on GET /metrics.
+ * Requests are handled one at a time on the listener's own thread, the page
+ * is produced by a render callback that must only read lock free state.
+ */
+
+/** appends the exposition text to the string */
+typedef std::function<void (std::string &)> MetricsRenderFunc;
+
+typedef struct _MetricsServer MetricsServer;
+
+/**
+ * Bind the listening socket and start serving.
+ *
+ * @param bind_address IPv4 address to listen on, "0.0.0.0" for all
+ * @param port TCP port
+ * @param render produces the page of every scrape, on the server thread
+ * @return NULL with errno set if the socket can't be bound
+ */
+MetricsServer *metrics_server_new (const char *bind_address, uint16_t port,
+    MetricsRenderFunc render);
+
+/** Stop the server thread and close the socket. */
+void metrics_server_free (MetricsServer *server);
+
+/** Append a "# HELP" and "# TYPE" header. */
+void metrics_append_header (std::string &out, const char *name,
+    const char *type, const char *help);
+
+/** Append a sample, @labels is the text between the braces or NULL. */
+void metrics_append_sample (std::string &out, const char *name,
+    const char *labels, double value);
+
+#endif /* __NVDSPOSTPROCESS_METRICS_H__ */
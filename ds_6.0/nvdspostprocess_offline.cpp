@@ -0,0 +1,606 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+/**
+ * Offline zone counting over recordings of the record-file property.
+ *
+ * The zones of a config file are applied to every recorded frame with the
+ * same engine as the element, so counts can be recomputed for new zones
+ * without running a pipeline. Sources are spread over worker threads, each
+ * worker maps the recordings itself and only reads the objects of its own
+ * sources. Recordings are processed in the order given, each one starting
+ * with empty tracks like a restarted element.
+ *
+ * Writes one CSV row per recording, rollup interval, source and zone, and a
+ * summary with the totals to stderr.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "nvdspostprocess_affinity.h"
+#include "nvdspostprocess_analytics.h"
+#include "nvdspostprocess_record.h"
+
+#define OFFLINE_DEFAULT_INTERVAL_S 60
+
+/** zone_min_overlap-N when it is not set, as in the element */
+#define OFFLINE_DEFAULT_MIN_OVERLAP 0.5
+
+/** [source-N] groups accepted, as in the element */
+#define OFFLINE_MAX_SOURCES 1024
+
+/** frame pts of frames recorded without timestamp */
+#define OFFLINE_PTS_NONE UINT64_MAX
+
+/** [source-N] group of the config file */
+typedef struct
+{
+  uint32_t source_id;
+  std::vector<AnalyticsZone> zones;
+  /** zone_anchor-N and zone_min_overlap-N by zone number */
+  std::vector<AnalyticsZoneAnchor> anchors;
+  /** zones and anchors compiled once, shared by the workers */
+  AnalyticsZoneSet zone_set;
+} OfflineSourceConfig;
+
+/** subset of the element config file used for counting */
+typedef struct
+{
+  /** counted classes, all when empty */
+  std::vector<int> object_ids;
+  /** enabled sources, sorted on source_id */
+  std::vector<OfflineSourceConfig> sources;
+} OfflineConfig;
+
+/** counts of a zone over a rollup interval */
+typedef struct
+{
+  uint32_t file;
+  uint64_t interval;
+  uint32_t source_id;
+  uint32_t zone;
+  uint64_t entries;
+  uint64_t occupancy_sum;
+  uint32_t occupancy_max;
+  uint64_t frames;
+} OfflineRow;
+
+/** counting state of a source owned by a worker */
+typedef struct
+{
+  const OfflineSourceConfig *config;
+  AnalyticsSource analytics;
+  /** interval being rolled up, valid when frames is not 0 */
+  uint64_t interval;
+  uint64_t frames;
+  /** zone entries when the interval started */
+  std::vector<uint64_t> entries_start;
+  std::vector<uint64_t> occupancy_sum;
+  std::vector<uint32_t> occupancy_max;
+} OfflineSource;
+
+typedef struct
+{
+  /** CPUs of one NUMA node the worker runs on, any CPU when empty */
+  std::vector<int> cpus;
+  std::vector<OfflineSource> sources;
+  /** index in sources of each source id, -1 for sources of other workers */
+  std::vector<int32_t> slot;
+  std::vector<OfflineRow> rows;
+  /** counted flag and zone mask of the objects of the batch being counted,
+   * the other columns are read in place from the recording */
+  std::vector<uint8_t> counted;
+  std::vector<uint64_t> zone_mask;
+  uint64_t frames;
+  uint64_t detections;
+  /** first error, the worker stops on it */
+  std::string error;
+} OfflineWorker;
+
+typedef struct
+{
+  const OfflineConfig *config;
+  const std::vector<const char *> *files;
+  uint64_t interval_ns;
+} OfflineJob;
+
+static std::string
+offline_strip (const std::string &str)
+{
+  size_t start = str.find_first_not_of (" \t\r");
+  size_t end = str.find_last_not_of (" \t\r");
+
+  return start == std::string::npos ? "" : str.substr (start, end - start + 1);
+}
+
+/* Integers of a ';' separated list, false if one of them is not a number. */
+static bool
+offline_parse_int_list (const std::string &value, std::vector<long> *list)
+{
+  size_t start = 0;
+
+  list->clear ();
+  while (start <= value.size ()) {
+    size_t end = value.find (';', start);
+    std::string item = offline_strip (value.substr (start,
+            end == std::string::npos ? std::string::npos : end - start));
+    char *endptr;
+
+    if (end == std::string::npos && item.empty ())
+      break;
+    errno = 0;
+    list->push_back (strtol (item.c_str (), &endptr, 10));
+    if (item.empty () || *endptr || errno)
+      return false;
+    if (end == std::string::npos)
+      break;
+    start = end + 1;
+  }
+  return true;
+}
+
+/*
+ * Read the [property] object_ids and the zone_cords-N, zone_anchor-N and
+ * zone_min_overlap-N of the enabled [source-N] groups of an element config
+ * file. The file is parsed like a
+ * GKeyFile with ';' as list separator, so that no GLib is needed.
+ */
+static bool
+offline_load_config (const char *path, OfflineConfig *config,
+    std::string *error)
+{
+  std::ifstream file (path);
+  std::string line, group;
+  OfflineSourceConfig source;
+  bool in_source = false, enabled = false;
+  std::vector<long> list;
+  unsigned line_num = 0;
+
+  if (!file) {
+    *error = std::string (path) + ": " + strerror (errno);
+    return false;
+  }
+
+  auto end_group = [&] () {
+    if (in_source && enabled)
+      config->sources.push_back (source);
+    in_source = false;
+  };
+
+  while (std::getline (file, line)) {
+    line_num++;
+    line = offline_strip (line);
+    if (line.empty () || line[0] == '#')
+      continue;
+
+    if (line[0] == '[') {
+      end_group ();
+      group = line.substr (1, line.find (']') - 1);
+      if (!group.compare (0, 7, "source-")) {
+        char *endptr;
+        unsigned long source_id = strtoul (group.c_str () + 7, &endptr, 10);
+
+        if (source_id >= OFFLINE_MAX_SOURCES) {
+          *error = std::string (path) + ":" + std::to_string (line_num) +
+              ": sources are numbered from 0 to " +
+              std::to_string (OFFLINE_MAX_SOURCES - 1);
+          return false;
+        }
+        source.source_id = source_id;
+        source.zones.clear ();
+        source.anchors.clear ();
+        in_source = true;
+        enabled = false;
+      }
+      continue;
+    }
+
+    size_t eq = line.find ('=');
+    if (eq == std::string::npos) {
+      *error = std::string (path) + ":" + std::to_string (line_num) +
+          ": expected key=value";
+      return false;
+    }
+    std::string key = offline_strip (line.substr (0, eq));
+    std::string value = offline_strip (line.substr (eq + 1));
+
+    if (group == "property" && key == "object_ids") {
+      if (!offline_parse_int_list (value, &list)) {
+        *error = std::string (path) + ":" + std::to_string (line_num) +
+            ": invalid object_ids";
+        return false;
+      }
+      config->object_ids.assign (list.begin (), list.end ());
+    } else if (in_source && key == "enable") {
+      enabled = value == "1" || value == "true";
+    } else if (in_source && !key.compare (0, 11, "zone_cords-")) {
+      AnalyticsZone zone;
+
+      /* x;y pairs followed by the r;g;b colour of the zone */
+      if (!offline_parse_int_list (value, &list) || list.size () < 9 ||
+          (list.size () - 3) % 2) {
+        *error = std::string (path) + ":" + std::to_string (line_num) +
+            ": " + key + " expects x;y pairs followed by r;g;b";
+        return false;
+      }
+      for (size_t i = 0; i + 3 < list.size (); i += 2)
+        zone.push_back ({(double) list[i], (double) list[i + 1]});
+      source.zones.push_back (zone);
+    } else if (in_source && (!key.compare (0, 12, "zone_anchor-") ||
+            !key.compare (0, 17, "zone_min_overlap-"))) {
+      bool is_anchor = key[5] == 'a';
+      char *endptr;
+      unsigned long zone = strtoul (key.c_str () + (is_anchor ? 12 : 17),
+          &endptr, 10);
+      double value_num = strtod (value.c_str (), &endptr);
+
+      if (zone >= ANALYTICS_MAX_ZONES || value.empty () || *endptr ||
+          (is_anchor ? (value_num != (int) value_num || value_num < 0 ||
+                  value_num >= ANALYTICS_ANCHOR_COUNT) :
+              !(value_num > 0.0 && value_num <= 1.0))) {
+        *error = std::string (path) + ":" + std::to_string (line_num) +
+            ": invalid " + key;
+        return false;
+      }
+      if (source.anchors.size () <= zone) {
+        source.anchors.resize (zone + 1, {ANALYTICS_ANCHOR_BOTTOM_CENTRE,
+              OFFLINE_DEFAULT_MIN_OVERLAP});
+      }
+      if (is_anchor)
+        source.anchors[zone].mode = (AnalyticsAnchorMode) (int) value_num;
+      else
+        source.anchors[zone].min_overlap = value_num;
+    }
+  }
+  end_group ();
+
+  std::sort (config->sources.begin (), config->sources.end (),
+      [] (const OfflineSourceConfig &a, const OfflineSourceConfig &b) {
+        return a.source_id < b.source_id;
+      });
+  for (OfflineSourceConfig &src : config->sources) {
+    analytics_zone_set_init (&src.zone_set, src.zones);
+    for (size_t z = 0; z < src.anchors.size (); z++)
+      analytics_zone_set_anchor (&src.zone_set, z, src.anchors[z]);
+  }
+  return true;
+}
+
+/* Close the interval of a source, one row per zone. */
+static void
+offline_flush (OfflineWorker *worker, OfflineSource *src, uint32_t file)
+{
+  if (!src->frames)
+    return;
+
+  for (size_t z = 0; z < src->config->zone_set.zones.size (); z++) {
+    worker->rows.push_back ({file, src->interval, src->config->source_id,
+        (uint32_t) z, src->analytics.entries[z] - src->entries_start[z],
+        src->occupancy_sum[z], src->occupancy_max[z], src->frames});
+  }
+  src->frames = 0;
+}
+
+static void
+offline_begin_interval (OfflineSource *src, uint64_t interval)
+{
+  src->interval = interval;
+  src->entries_start = src->analytics.entries;
+  std::fill (src->occupancy_sum.begin (), src->occupancy_sum.end (), 0);
+  std::fill (src->occupancy_max.begin (), src->occupancy_max.end (), 0);
+}
+
+/* Count the frames of the worker's sources in one recording. */
+static bool
+offline_process_file (OfflineWorker *worker, const OfflineJob *job,
+    uint32_t file)
+{
+  RecordReader *reader = record_reader_open ((*job->files)[file]);
+  RecordBatchView view;
+  AnalyticsFrameResult result;
+
+  if (!reader) {
+    worker->error = std::string ((*job->files)[file]) + ": " +
+        (errno == EINVAL ? "not a recording" : strerror (errno));
+    return false;
+  }
+
+  for (OfflineSource &src : worker->sources) {
+    size_t num_zones = src.config->zone_set.zones.size ();
+
+    analytics_source_init (&src.analytics, &src.config->zone_set);
+    src.frames = 0;
+    src.entries_start.assign (num_zones, 0);
+    src.occupancy_sum.assign (num_zones, 0);
+    src.occupancy_max.assign (num_zones, 0);
+  }
+
+  while (record_reader_next (reader, &view)) {
+    uint32_t first = 0;
+
+    worker->counted.resize (view.num_objects);
+    worker->zone_mask.resize (view.num_objects);
+    for (uint32_t o = 0; o < view.num_objects; o++) {
+      worker->counted[o] = analytics_is_counted_class (job->config->object_ids,
+          view.class_id[o]);
+    }
+    AnalyticsObjects objects = {view.left, view.top, view.width, view.height,
+        view.object_id, worker->counted.data (), worker->zone_mask.data ()};
+
+    for (uint32_t i = 0; i < view.num_frames; i++) {
+      uint32_t num_objects = view.frame_num_objects[i];
+      uint32_t source_id = view.source_id[i];
+      uint64_t interval;
+
+      first += num_objects;
+      if (first > view.num_objects)
+        break;
+      if (source_id >= worker->slot.size () || worker->slot[source_id] < 0)
+        continue;
+
+      OfflineSource &src = worker->sources[worker->slot[source_id]];
+      interval = view.frame_pts[i] == OFFLINE_PTS_NONE ? 0 :
+          view.frame_pts[i] / job->interval_ns;
+      if (!src.frames || interval != src.interval) {
+        offline_flush (worker, &src, file);
+        offline_begin_interval (&src, interval);
+      }
+
+      AnalyticsObjects frame_objects =
+          analytics_objects_slice (objects, first - num_objects);
+      analytics_process_frame (&src.analytics, &frame_objects, num_objects,
+          &result);
+
+      for (size_t z = 0; z < src.config->zone_set.zones.size (); z++) {
+        src.occupancy_sum[z] += src.analytics.occupancy[z];
+        src.occupancy_max[z] = std::max (src.occupancy_max[z],
+            src.analytics.occupancy[z]);
+      }
+      src.frames++;
+      worker->frames++;
+      worker->detections += num_objects;
+    }
+  }
+
+  for (OfflineSource &src : worker->sources)
+    offline_flush (worker, &src, file);
+  record_reader_close (reader);
+  return true;
+}
+
+static void
+offline_worker_run (OfflineWorker *worker, const OfflineJob *job)
+{
+  /* Before the worker allocates the state of its sources, which the local
+   * allocation policy then usually places on its node. */
+  if (!worker->cpus.empty () &&
+      !affinity_pin_current_thread (worker->cpus)) {
+    worker->error = std::string ("could not pin a worker: ") +
+        strerror (errno);
+    return;
+  }
+
+  for (uint32_t file = 0; file < job->files->size (); file++)
+    if (!offline_process_file (worker, job, file))
+      return;
+}
+
+static void
+offline_usage (FILE *out)
+{
+  fprintf (out,
+      "Usage: nvdspostprocess-offline -c CONFIG [-j THREADS] [-a CPUS] "
+      "[-i SECONDS] [-o OUTPUT] RECORDING...\n"
+      "Count the zones of CONFIG over recordings of the nvdspostprocess "
+      "record-file property.\n\n"
+      "  -c CONFIG   nvdspostprocess config file with the zones\n"
+      "  -j THREADS  worker threads, default one per core or per CPU of -a\n"
+      "  -a CPUS     CPU list (e.g. 0-7,16-23) the workers are pinned to, "
+      "spread\n"
+      "              over its NUMA nodes with every source staying on one "
+      "worker\n"
+      "  -i SECONDS  rollup interval on the frame timestamps, default %d\n"
+      "  -o OUTPUT   CSV output, default stdout\n",
+      OFFLINE_DEFAULT_INTERVAL_S);
+}
+
+int
+main (int argc, char *argv[])
+{
+  const char *config_path = NULL, *output_path = NULL, *cpu_list = NULL;
+  unsigned num_threads = std::thread::hardware_concurrency ();
+  double interval_s = OFFLINE_DEFAULT_INTERVAL_S;
+  std::vector<const char *> files;
+  std::vector<OfflineWorker> workers;
+  std::vector<std::thread> threads;
+  std::vector<int> cpus;
+  std::vector<std::vector<int>> node_cpus;
+  bool threads_set = false;
+  std::vector<OfflineRow> rows;
+  OfflineConfig config;
+  OfflineJob job;
+  std::string error;
+  uint64_t frames = 0, detections = 0;
+  FILE *out = stdout;
+  int opt;
+
+  while ((opt = getopt (argc, argv, "c:j:a:i:o:h")) != -1) {
+    switch (opt) {
+      case 'c':
+        config_path = optarg;
+        break;
+      case 'j':
+        num_threads = strtoul (optarg, NULL, 10);
+        threads_set = true;
+        break;
+      case 'a':
+        cpu_list = optarg;
+        break;
+      case 'i':
+        interval_s = strtod (optarg, NULL);
+        break;
+      case 'o':
+        output_path = optarg;
+        break;
+      case 'h':
+        offline_usage (stdout);
+        return 0;
+      default:
+        offline_usage (stderr);
+        return 2;
+    }
+  }
+  for (int i = optind; i < argc; i++)
+    files.push_back (argv[i]);
+  if (!config_path || files.empty () || !(interval_s > 0.0)) {
+    offline_usage (stderr);
+    return 2;
+  }
+
+  if (cpu_list) {
+    if (!affinity_parse_cpus (cpu_list, &cpus)) {
+      fprintf (stderr, "%s: invalid CPU list\n", cpu_list);
+      return 2;
+    }
+    node_cpus = affinity_split_by_node (cpus);
+    if (!threads_set)
+      num_threads = cpus.size ();
+  }
+
+  if (!offline_load_config (config_path, &config, &error)) {
+    fprintf (stderr, "%s\n", error.c_str ());
+    return 1;
+  }
+  if (config.sources.empty ()) {
+    fprintf (stderr, "%s: no enabled [source-N] group\n", config_path);
+    return 1;
+  }
+
+  /* Round robin over the sorted sources, each source has a single owner so
+   * its tracks never need locking. */
+  num_threads = std::max (1u, std::min<unsigned> (num_threads,
+          config.sources.size ()));
+  workers.resize (num_threads);
+  for (size_t w = 0; w < workers.size () && !node_cpus.empty (); w++)
+    workers[w].cpus = node_cpus[w % node_cpus.size ()];
+  for (size_t i = 0; i < config.sources.size (); i++) {
+    OfflineWorker &worker = workers[i % num_threads];
+    uint32_t source_id = config.sources[i].source_id;
+
+    if (worker.slot.size () <= source_id)
+      worker.slot.resize (source_id + 1, -1);
+    worker.slot[source_id] = worker.sources.size ();
+    worker.sources.push_back (OfflineSource ());
+    worker.sources.back ().config = &config.sources[i];
+  }
+
+  job.config = &config;
+  job.files = &files;
+  job.interval_ns = (uint64_t) (interval_s * 1e9);
+
+  auto start = std::chrono::steady_clock::now ();
+  for (OfflineWorker &worker : workers)
+    threads.emplace_back (offline_worker_run, &worker, &job);
+  for (std::thread &thread : threads)
+    thread.join ();
+  double elapsed = std::chrono::duration<double> (
+      std::chrono::steady_clock::now () - start).count ();
+
+  for (OfflineWorker &worker : workers) {
+    if (!worker.error.empty ()) {
+      fprintf (stderr, "%s\n", worker.error.c_str ());
+      return 1;
+    }
+    rows.insert (rows.end (), worker.rows.begin (), worker.rows.end ());
+    frames += worker.frames;
+    detections += worker.detections;
+  }
+  std::sort (rows.begin (), rows.end (),
+      [] (const OfflineRow &a, const OfflineRow &b) {
+        if (a.file != b.file)
+          return a.file < b.file;
+        if (a.interval != b.interval)
+          return a.interval < b.interval;
+        if (a.source_id != b.source_id)
+          return a.source_id < b.source_id;
+        return a.zone < b.zone;
+      });
+
+  if (output_path && !(out = fopen (output_path, "w"))) {
+    fprintf (stderr, "%s: %s\n", output_path, strerror (errno));
+    return 1;
+  }
+  fprintf (out, "recording,interval_start_s,source_id,zone,entries,"
+      "occupancy_mean,occupancy_max,frames\n");
+  for (const OfflineRow &row : rows) {
+    fprintf (out, "%s,%.3f,%u,%u,%lu,%.3f,%u,%lu\n", files[row.file],
+        row.interval * interval_s, row.source_id, row.zone,
+        (unsigned long) row.entries,
+        (double) row.occupancy_sum / row.frames, row.occupancy_max,
+        (unsigned long) row.frames);
+  }
+  if (out != stdout && fclose (out)) {
+    fprintf (stderr, "%s: %s\n", output_path, strerror (errno));
+    return 1;
+  }
+
+  /* Totals over all the recordings */
+  for (const OfflineSourceConfig &source : config.sources) {
+    for (size_t z = 0; z < std::min<size_t> (source.zones.size (),
+            ANALYTICS_MAX_ZONES); z++) {
+      uint64_t entries = 0, occupancy_sum = 0, zone_frames = 0;
+
+      for (const OfflineRow &row : rows) {
+        if (row.source_id == source.source_id && row.zone == z) {
+          entries += row.entries;
+          occupancy_sum += row.occupancy_sum;
+          zone_frames += row.frames;
+        }
+      }
+      fprintf (stderr, "source %u zone %zu: %lu entries, mean occupancy "
+          "%.3f over %lu frames\n", source.source_id, z,
+          (unsigned long) entries,
+          zone_frames ? (double) occupancy_sum / zone_frames : 0.0,
+          (unsigned long) zone_frames);
+    }
+  }
+  fprintf (stderr, "%lu frames, %lu detections in %.3f s with %u threads, "
+      "%.1f M detections/min\n", (unsigned long) frames,
+      (unsigned long) detections, elapsed, num_threads,
+      elapsed > 0.0 ? detections / elapsed * 60e-6 : 0.0);
+  if (!node_cpus.empty ()) {
+    fprintf (stderr, "workers pinned to CPUs %s over %zu NUMA nodes\n",
+        cpu_list, std::min<size_t> (num_threads, node_cpus.size ()));
+  }
+
+  return 0;
+}
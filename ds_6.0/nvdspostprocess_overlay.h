@@ -0,0 +1,149 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __NVDSPOSTPROCESS_OVERLAY_H__
+#define __NVDSPOSTPROCESS_OVERLAY_H__
+
+#include <stdint.h>
+#include <vector>
+
+/**
+ * CPU rasterizer used to draw zones and boxes straight into RGBA surfaces.
+ * Only depends on the standard library so that it can run on any
+ * CPU accessible plane (NVBUF_MEM_SYSTEM, NVBUF_MEM_CUDA_UNIFIED ...).
+ */
+
+/** max number of dirty rectangles kept per frame before they get merged */
+#define OVERLAY_MAX_DIRTY_RECTS 16
+
+/** RGBA colour, alpha 255 is opaque */
+typedef struct
+{
+  uint8_t r, g, b, a;
+} OverlayColor;
+
+/** integer pixel position */
+typedef struct
+{
+  int32_t x, y;
+} OverlayPoint;
+
+/** rectangle, right and bottom are exclusive */
+typedef struct
+{
+  int32_t left, top, right, bottom;
+} OverlayRect;
+
+/** polygon edge prepared for scanline filling */
+typedef struct
+{
+  /** first and last (exclusive) scanline crossed by the edge */
+  int32_t y_start, y_end;
+  /** x at the centre of y_start and increment per scanline */
+  float x, dxdy;
+} OverlayEdge;
+
+/** zone polygon, compiled once with the config file */
+typedef struct
+{
+  std::vector<OverlayPoint> pts;
+  /** non horizontal edges sorted on y_start */
+  std::vector<OverlayEdge> edges;
+  /** bounding box of the polygon */
+  OverlayRect bounds;
+  /** outline colour */
+  OverlayColor border;
+} OverlayPolygon;
+
+/** RGBA plane the rasterizer draws into */
+typedef struct
+{
+  uint8_t *data;
+  uint32_t width;
+  uint32_t height;
+  /** bytes per row */
+  uint32_t pitch;
+  /** regions touched while drawing the current frame */
+  std::vector<OverlayRect> dirty;
+} OverlaySurface;
+
+/** scratch reused between frames so that filling does not allocate */
+typedef struct
+{
+  std::vector<OverlayEdge> active;
+  std::vector<float> xs;
+} OverlayScratch;
+
+/**
+ * Build the edge table and bounds of a polygon.
+ *
+ * @param poly polygon with pts filled in
+ */
+void overlay_compile_polygon (OverlayPolygon *poly);
+
+/**
+ * Point the surface to a new frame and forget the previous dirty regions.
+ */
+void overlay_begin_frame (OverlaySurface *surf, uint8_t *data, uint32_t width,
+    uint32_t height, uint32_t pitch);
+
+/**
+ * Blend a colour over @npix consecutive RGBA pixels.
+ */
+void overlay_blend_span (uint8_t *dst, uint32_t npix, OverlayColor color);
+
+/**
+ * Blend a colour over @npix consecutive RGBA pixels using a per pixel
+ * coverage mask, the effective alpha is mask * color.a / 255.
+ */
+void overlay_blend_mask_span (uint8_t *dst, const uint8_t *mask, uint32_t npix,
+    OverlayColor color);
+
+/**
+ * Blend a colour through an 8 bit coverage mask placed at (@x, @y), clipped
+ * to the surface.
+ */
+void overlay_blend_mask (OverlaySurface *surf, const uint8_t *mask,
+    uint32_t mask_width, uint32_t mask_height, int32_t x, int32_t y,
+    OverlayColor color);
+
+/** Blend a filled rectangle, clipped to the surface. */
+void overlay_fill_rect (OverlaySurface *surf, OverlayRect rect,
+    OverlayColor color);
+
+/** Draw the outline of a rectangle with the given thickness inside @rect. */
+void overlay_draw_rect (OverlaySurface *surf, OverlayRect rect,
+    uint32_t thickness, OverlayColor color);
+
+/** Draw a line with a square pen of the given thickness. */
+void overlay_draw_line (OverlaySurface *surf, OverlayPoint p0, OverlayPoint p1,
+    uint32_t thickness, OverlayColor color);
+
+/** Scanline fill of the polygon interior with @color. */
+void overlay_fill_polygon (OverlaySurface *surf, const OverlayPolygon *poly,
+    OverlayColor color, OverlayScratch *scratch);
+
+/** Closed outline of the polygon with poly->border. */
+void overlay_draw_polygon (OverlaySurface *surf, const OverlayPolygon *poly,
+    uint32_t thickness);
+
+#endif /* __NVDSPOSTPROCESS_OVERLAY_H__ */
@@ -134,15 +134,17 @@ gint sum_total_rois = 0;
 
 static gboolean
 nvdspostprocess_parse_property_group (GstNvDsPostProcess *nvdspostprocess,
-    gchar *cfg_file_path, GKeyFile *key_file, gchar *group);
+    GstNvDsPostProcessConfig *config, const gchar *cfg_file_path,
+    GKeyFile *key_file, gchar *group);
 
 static gboolean
 nvdspostprocess_parse_common_group (GstNvDsPostProcess *nvdspostprocess,
-    gchar *cfg_file_path, GKeyFile *key_file, gchar *group, guint64 group_id);
+    GstNvDsPostProcessConfig *config, const gchar *cfg_file_path,
+    GKeyFile *key_file, gchar *group, guint64 group_id);
 
 static gboolean
 nvdspostprocess_parse_user_configs(GstNvDsPostProcess *nvdspostprocess,
-    gchar *cfg_file_path, GKeyFile *key_file, gchar *group);
+    const gchar *cfg_file_path, GKeyFile *key_file, gchar *group);
 
 /* Get the absolute path of a file mentioned in the config given a
  * file path absolute/relative to the config file. */
@@ -197,7 +199,8 @@ get_absolute_file_path (
 
 static gboolean
 nvdspostprocess_parse_property_group (GstNvDsPostProcess *nvdspostprocess,
-    gchar *cfg_file_path, GKeyFile *key_file, gchar *group)
+    GstNvDsPostProcessConfig *config, const gchar *cfg_file_path,
+    GKeyFile *key_file, gchar *group)
 {
   g_autoptr(GError)error = nullptr;
   gboolean ret = FALSE;
@@ -214,7 +217,7 @@ nvdspostprocess_parse_property_group (GstNvDsPostProcess *nvdspostprocess,
       gboolean val = g_key_file_get_boolean(key_file, group,
           NVDSPOSTPROCESS_PROPERTY_ENABLE, &error);
       CHECK_ERROR(error, group);
-      nvdspostprocess->enable = val;
+      config->enable = val;
     }
     
     else if (!g_strcmp0 (*key, NVDSPOSTPROCESS_PROPERTY_OBJECT_IDS)) {
@@ -222,50 +225,50 @@ nvdspostprocess_parse_property_group (GstNvDsPostProcess *nvdspostprocess,
       if (object_ids_list == nullptr) {
         CHECK_ERROR(error, group);
       }
-      nvdspostprocess->object_ids.clear();
+      config->object_ids.clear();
       for (gsize icnt = 0; icnt < object_ids_list_len; icnt++){
-        nvdspostprocess->object_ids.push_back(object_ids_list[icnt]);
+        config->object_ids.push_back(object_ids_list[icnt]);
         GST_CAT_INFO (NVDSPOSTPROCESS_CFG_PARSER_CAT, "Parsed '%s=%d' in group '%s'\n",
           *key, object_ids_list[icnt], group);
       }
       g_free(object_ids_list);
       object_ids_list = nullptr;
-      nvdspostprocess->property_set.object_ids = TRUE;
+      config->property_set.object_ids = TRUE;
     }
     
     else if (!g_strcmp0(*key, NVDSPOSTPROCESS_PROPERTY_CUSTOM_LIB_NAME)) {
       gchar *str = g_key_file_get_string (key_file, group, *key, &error);
-      nvdspostprocess->custom_lib_path = new gchar[_PATH_MAX];
-      if (!get_absolute_file_path (cfg_file_path, str, nvdspostprocess->custom_lib_path)) {
+      config->custom_lib_path = new gchar[_PATH_MAX];
+      if (!get_absolute_file_path (cfg_file_path, str, config->custom_lib_path)) {
         g_printerr ("Error: Could not parse custom lib path\n");
         g_free (str);
         ret = FALSE;
-        delete[] nvdspostprocess->custom_lib_path;
+        delete[] config->custom_lib_path;
         goto done;
       }
       g_free (str);
       GST_CAT_INFO (NVDSPOSTPROCESS_CFG_PARSER_CAT, "Parsed %s=%s in group '%s'\n",
-          *key, nvdspostprocess->custom_lib_path, group);
-      nvdspostprocess->property_set.custom_lib_path = TRUE;
+          *key, config->custom_lib_path, group);
+      config->property_set.custom_lib_path = TRUE;
     }
     else if (!g_strcmp0(*key, NVDSPOSTPROCESS_PROPERTY_TENSOR_PREPARATION_FUNCTION)) {
-      GET_STRING_PROPERTY(group, *key, nvdspostprocess->custom_tensor_function_name);
+      GET_STRING_PROPERTY(group, *key, config->custom_tensor_function_name);
       GST_CAT_INFO (NVDSPOSTPROCESS_CFG_PARSER_CAT, "Parsed %s=%s in group '%s'\n",
-          *key, nvdspostprocess->custom_tensor_function_name, group);
-      nvdspostprocess->property_set.custom_tensor_function_name = TRUE;
+          *key, config->custom_tensor_function_name, group);
+      config->property_set.custom_tensor_function_name = TRUE;
     }
   }
 
-  if (!(nvdspostprocess->property_set.object_ids &&
-      nvdspostprocess->property_set.custom_lib_path &&
-      nvdspostprocess->property_set.custom_tensor_function_name)) {
+  /* custom-lib-path and custom-tensor-preparation-function are optional,
+   * no custom library is loaded yet. */
+  if (!config->property_set.object_ids) {
     printf("ERROR: Some postprocess config properties not set\n");
     return FALSE;
   }
 
   
   GST_DEBUG_OBJECT (nvdspostprocess, "Custom Lib = %s\n Custom Tensor Preparation Function = %s\n",
-          nvdspostprocess->custom_lib_path, nvdspostprocess->custom_tensor_function_name);
+          config->custom_lib_path, config->custom_tensor_function_name);
 
   ret = TRUE;
 
@@ -273,9 +276,42 @@ done:
   return ret;
 }
 
+/* Compile the zones of a parsed group for the analytics engine and the
+ * overlay. Done once per config, the instances only keep their counts and
+ * tracks. */
+static void
+nvdspostprocess_compile_group (GstNvDsPostProcessGroupConfig *group)
+{
+  std::vector<AnalyticsZone> zones;
+  for (guint zcnt = 0; zcnt < group->zone_pts.size(); zcnt++) {
+    const gdoublevec &color = group->zone_color[zcnt];
+    AnalyticsZone zone;
+    OverlayPolygon poly;
+    for (const Point &pt : group->zone_pts[zcnt]) {
+      zone.push_back ({(gdouble) pt.x, (gdouble) pt.y});
+      poly.pts.push_back ({(int32_t) pt.x, (int32_t) pt.y});
+    }
+    zones.push_back (zone);
+    poly.border = {(uint8_t) (color[0] * 255), (uint8_t) (color[1] * 255),
+        (uint8_t) (color[2] * 255), 255};
+    overlay_compile_polygon (&poly);
+    group->overlay_zones.push_back (poly);
+  }
+  analytics_zone_set_init (&group->zone_set, zones);
+  for (guint z = 0; z < group->zone_anchors.size(); z++) {
+    analytics_zone_set_anchor (&group->zone_set, z,
+        group->zone_anchors[z]);
+  }
+  for (guint z = 0; z < group->zone_coverage.size(); z++) {
+    analytics_zone_set_coverage (&group->zone_set, z,
+        group->zone_coverage[z]);
+  }
+}
+
 static gboolean
 nvdspostprocess_parse_common_group (GstNvDsPostProcess *nvdspostprocess,
-    gchar *cfg_file_path, GKeyFile *key_file, gchar *group, guint64 group_id)
+    GstNvDsPostProcessConfig *config, const gchar *cfg_file_path,
+    GKeyFile *key_file, gchar *group, guint64 group_id)
 {
   g_autoptr(GError)error = nullptr;
   gboolean ret = FALSE;
@@ -288,11 +324,17 @@ nvdspostprocess_parse_common_group (GstNvDsPostProcess *nvdspostprocess,
   gsize roi_list_len = 0;
   gsize zone_list_len = 0;
   gint num_point_per_zone = 0;
-  GstNvDsPostProcessGroup *postprocess_group;
+  GstNvDsPostProcessGroupConfig *postprocess_group;
   Points pts;
   std::vector <gdouble> zone_color;
   std::vector <gint> zone_approach;
-  postprocess_group = new GstNvDsPostProcessGroup;
+
+  /* The element indexes its groups by source id. */
+  if (group_id >= NVDSPOSTPROCESS_MAX_SOURCES) {
+    PARSE_ERROR ("Group '%s': sources are numbered from 0 to %d", group,
+        NVDSPOSTPROCESS_MAX_SOURCES - 1);
+  }
+  postprocess_group = new GstNvDsPostProcessGroupConfig;
   //postprocess_group->points;
   postprocess_group->src_id = group_id;
   keys = g_key_file_get_keys (key_file, group, nullptr, &error);
@@ -312,7 +354,7 @@ nvdspostprocess_parse_common_group (GstNvDsPostProcess *nvdspostprocess,
           *key, zone_list[icnt], group);
       }
       postprocess_group->zone_ids = zone_ids;
-      nvdspostprocess->property_set.zone_ids = TRUE;
+      config->property_set.zone_ids = TRUE;
       g_free(zone_list);
       zone_list = nullptr;
     }
@@ -330,7 +372,7 @@ nvdspostprocess_parse_common_group (GstNvDsPostProcess *nvdspostprocess,
       postprocess_group->enable = val;
       GST_CAT_INFO (NVDSPOSTPROCESS_CFG_PARSER_CAT, "Parsed %s=%d in group '%s'\n",
             *key, postprocess_group->enable, group);
-      nvdspostprocess->property_set.enable = TRUE;
+      config->property_set.enable = TRUE;
     }
     else if (!strncmp(*key, NVDSPOSTPROCESS_GROUP_ZONE_CORDS,
       sizeof(NVDSPOSTPROCESS_GROUP_ZONE_CORDS)-1) && postprocess_group->enable) {
@@ -374,7 +416,7 @@ nvdspostprocess_parse_common_group (GstNvDsPostProcess *nvdspostprocess,
 
         GST_CAT_INFO (NVDSPOSTPROCESS_CFG_PARSER_CAT, "Parsed '%s' in group '%s'\n",
           NVDSPOSTPROCESS_GROUP_ZONE_CORDS, group);
-        nvdspostprocess->property_set.zone_cords = TRUE;
+        config->property_set.zone_cords = TRUE;
 
         g_free(roi_list);
         roi_list = nullptr;
@@ -405,18 +447,70 @@ nvdspostprocess_parse_common_group (GstNvDsPostProcess *nvdspostprocess,
 
         GST_CAT_INFO (NVDSPOSTPROCESS_CFG_PARSER_CAT, "Parsed '%s' in group '%s'\n",
           NVDSPOSTPROCESS_GROUP_ZONE_APPROACH, group);
-        nvdspostprocess->property_set.zone_approach = TRUE;
+        config->property_set.zone_approach = TRUE;
 
         
     }
 
+    else if ((!strncmp(*key, NVDSPOSTPROCESS_GROUP_ZONE_ANCHOR,
+            sizeof(NVDSPOSTPROCESS_GROUP_ZONE_ANCHOR)-1) ||
+        !strncmp(*key, NVDSPOSTPROCESS_GROUP_ZONE_MIN_OVERLAP,
+            sizeof(NVDSPOSTPROCESS_GROUP_ZONE_MIN_OVERLAP)-1)) &&
+        postprocess_group->enable) {
+        EXTRACT_ZONE_ID(key);
+        if (zone_index >= NVDSPOSTPROCESS_MAX_ZONES) {
+          PARSE_ERROR ("'%s' in group '%s': zones are numbered from 0 to %d",
+              *key, group, NVDSPOSTPROCESS_MAX_ZONES - 1);
+        }
+        if (postprocess_group->zone_anchors.size() <= zone_index) {
+          postprocess_group->zone_anchors.resize (zone_index + 1,
+              {ANALYTICS_ANCHOR_BOTTOM_CENTRE,
+                  NVDSPOSTPROCESS_DEFAULT_MIN_OVERLAP});
+        }
+        AnalyticsZoneAnchor &anchor = postprocess_group->zone_anchors[zone_index];
+
+        if (!strncmp(*key, NVDSPOSTPROCESS_GROUP_ZONE_ANCHOR,
+              sizeof(NVDSPOSTPROCESS_GROUP_ZONE_ANCHOR)-1)) {
+          gint mode = g_key_file_get_integer (key_file, group, *key, &error);
+          CHECK_ERROR(error, group);
+          CHECK_INT_VALUE_RANGE(*key, mode, group, 0, ANALYTICS_ANCHOR_COUNT - 1);
+          anchor.mode = (AnalyticsAnchorMode) mode;
+        } else {
+          gdouble ratio = g_key_file_get_double (key_file, group, *key, &error);
+          CHECK_ERROR(error, group);
+          if (!(ratio > 0.0 && ratio <= 1.0)) {
+            PARSE_ERROR ("'%s' in group '%s' must be in (0, 1]", *key, group);
+          }
+          anchor.min_overlap = ratio;
+        }
+        GST_CAT_INFO (NVDSPOSTPROCESS_CFG_PARSER_CAT, "Parsed '%s' in group '%s'\n",
+          *key, group);
+    }
+
+    else if (!strncmp(*key, NVDSPOSTPROCESS_GROUP_ZONE_COVERAGE,
+            sizeof(NVDSPOSTPROCESS_GROUP_ZONE_COVERAGE)-1) &&
+        postprocess_group->enable) {
+        EXTRACT_ZONE_ID(key);
+        if (zone_index >= NVDSPOSTPROCESS_MAX_ZONES) {
+          PARSE_ERROR ("'%s' in group '%s': zones are numbered from 0 to %d",
+              *key, group, NVDSPOSTPROCESS_MAX_ZONES - 1);
+        }
+        gboolean val = g_key_file_get_boolean (key_file, group, *key, &error);
+        CHECK_ERROR(error, group);
+        if (postprocess_group->zone_coverage.size() <= zone_index)
+          postprocess_group->zone_coverage.resize (zone_index + 1, FALSE);
+        postprocess_group->zone_coverage[zone_index] = val;
+        GST_CAT_INFO (NVDSPOSTPROCESS_CFG_PARSER_CAT, "Parsed %s=%d in group '%s'\n",
+          *key, val, group);
+    }
+
     else  if (!g_strcmp0 (*key, NVDSPOSTPROCESS_GROUP_REMOVE_UNCOUNTED)) {
       gboolean val = g_key_file_get_boolean(key_file, group, *key, &error);
       CHECK_ERROR(error, group);
       postprocess_group->remove_uncounted = val;
       GST_CAT_INFO (NVDSPOSTPROCESS_CFG_PARSER_CAT, "Parsed %s=%d in group '%s'\n",
             *key, postprocess_group->enable, group);
-      nvdspostprocess->property_set.remove_uncounted = TRUE;
+      config->property_set.remove_uncounted = TRUE;
     } 
     else  if (!g_strcmp0 (*key, NVDSPOSTPROCESS_GROUP_FCM_FACTOR)) {
       double val = g_key_file_get_double(key_file, group, *key, &error);
@@ -424,7 +518,22 @@ nvdspostprocess_parse_common_group (GstNvDsPostProcess *nvdspostprocess,
       postprocess_group->fcm_factor = val;
       GST_CAT_INFO (NVDSPOSTPROCESS_CFG_PARSER_CAT, "Parsed %s=%d in group '%s'\n",
             *key, postprocess_group->enable, group);
-      nvdspostprocess->property_set.fcm_factor = TRUE;
+      config->property_set.fcm_factor = TRUE;
+    } 
+    else  if (!g_strcmp0 (*key, NVDSPOSTPROCESS_GROUP_INTERVAL)) {
+      gint val = g_key_file_get_integer(key_file, group, *key, &error);
+      CHECK_ERROR(error, group);
+      CHECK_INT_VALUE_RANGE(*key, val, group, 1, G_MAXINT);
+      postprocess_group->interval = val;
+      GST_CAT_INFO (NVDSPOSTPROCESS_CFG_PARSER_CAT, "Parsed %s=%d in group '%s'\n",
+            *key, val, group);
+    } 
+    else  if (!g_strcmp0 (*key, NVDSPOSTPROCESS_GROUP_LOW_PRIORITY)) {
+      gboolean val = g_key_file_get_boolean(key_file, group, *key, &error);
+      CHECK_ERROR(error, group);
+      postprocess_group->low_priority = val;
+      GST_CAT_INFO (NVDSPOSTPROCESS_CFG_PARSER_CAT, "Parsed %s=%d in group '%s'\n",
+            *key, val, group);
     } 
 
 
@@ -435,14 +544,15 @@ nvdspostprocess_parse_common_group (GstNvDsPostProcess *nvdspostprocess,
 
   }
 
-  nvdspostprocess->nvdspostprocess_groups.push_back(postprocess_group);
+  nvdspostprocess_compile_group (postprocess_group);
+  config->groups.push_back(postprocess_group);
 
   if (postprocess_group->enable) {
-    if (!(nvdspostprocess->property_set.zone_ids &&
-        nvdspostprocess->property_set.fcm_factor &&
-        nvdspostprocess->property_set.zone_approach &&
-        nvdspostprocess->property_set.remove_uncounted &&
-        nvdspostprocess->property_set.zone_cords)) {
+    if (!(config->property_set.zone_ids &&
+        config->property_set.fcm_factor &&
+        config->property_set.zone_approach &&
+        config->property_set.remove_uncounted &&
+        config->property_set.zone_cords)) {
       printf("ERROR: Some postprocess group config properties not set\n");
       return FALSE;
     }
@@ -456,7 +566,7 @@ done:
 
 static gboolean
 nvdspostprocess_parse_user_configs(GstNvDsPostProcess *nvdspostprocess,
-    gchar *cfg_file_path, GKeyFile *key_file, gchar *group)
+    const gchar *cfg_file_path, GKeyFile *key_file, gchar *group)
 {
   g_autoptr(GError)error = nullptr;
   gboolean ret = FALSE;
@@ -480,9 +590,12 @@ done:
   return ret;
 }
 
-/* Parse the nvdspostprocess config file. Returns FALSE in case of an error. */
-gboolean
-nvdspostprocess_parse_config_file (GstNvDsPostProcess * nvdspostprocess, gchar * cfg_file_path)
+/* Parse the nvdspostprocess config file read into @contents. Returns FALSE
+ * in case of an error. */
+static gboolean
+nvdspostprocess_parse_config_file (GstNvDsPostProcess * nvdspostprocess,
+    GstNvDsPostProcessConfig * config, const gchar * cfg_file_path,
+    const gchar * contents, gsize length)
 {
   g_autoptr(GError)error = nullptr;
   gboolean ret = FALSE;
@@ -500,7 +613,7 @@ nvdspostprocess_parse_config_file (GstNvDsPostProcess * nvdspostprocess, gchar *
       gst_debug_category_set_threshold (NVDSPOSTPROCESS_CFG_PARSER_CAT, GST_LEVEL_ERROR);
   }
 
-  if (!g_key_file_load_from_file (cfg_file, cfg_file_path, G_KEY_FILE_NONE,
+  if (!g_key_file_load_from_data (cfg_file, contents, length, G_KEY_FILE_NONE,
           &error)) {
     PARSE_ERROR ("%s", error->message);
   }
@@ -517,7 +630,7 @@ nvdspostprocess_parse_config_file (GstNvDsPostProcess * nvdspostprocess, gchar *
   for (group = groups; *group; group++) {
     GST_CAT_INFO (NVDSPOSTPROCESS_CFG_PARSER_CAT, "Group found %s \n", *group);
     if (!strcmp(*group, NVDSPOSTPROCESS_PROPERTY)){
-      ret = nvdspostprocess_parse_property_group(nvdspostprocess,
+      ret = nvdspostprocess_parse_property_group(nvdspostprocess, config,
           cfg_file_path, cfg_file, *group);
       if (!ret){
         g_print("NVDSPOSTPROCESS_CFG_PARSER: Group '%s' parse failed\n", *group);
@@ -528,7 +641,7 @@ nvdspostprocess_parse_config_file (GstNvDsPostProcess * nvdspostprocess, gchar *
             sizeof(NVDSPOSTPROCESS_GROUP)-1)){
       EXTRACT_GROUP_ID(NVDSPOSTPROCESS_GROUP);
       GST_DEBUG("parsing group index = %lu\n", group_index);
-      ret = nvdspostprocess_parse_common_group (nvdspostprocess,
+      ret = nvdspostprocess_parse_common_group (nvdspostprocess, config,
                 cfg_file_path, cfg_file, *group, group_index);
       if (!ret){
         g_print("NVDSPOSTPROCESS_CFG_PARSER: Group '%s' parse failed\n", *group);
@@ -552,4 +665,96 @@ nvdspostprocess_parse_config_file (GstNvDsPostProcess * nvdspostprocess, gchar *
 
 done:
   return ret;
-}
\ No newline at end of file
+}
+
+static void
+nvdspostprocess_config_free (GstNvDsPostProcessConfig * config)
+{
+  for (GstNvDsPostProcessGroupConfig *group : config->groups) {
+    g_free (group->custom_transform_function_name);
+    delete group;
+  }
+  delete[] config->custom_lib_path;
+  g_free (config->custom_tensor_function_name);
+  delete config;
+}
+
+/* Parsed configs by canonical path and content hash. Instances parse a file
+ * the cache does not have yet outside of the lock, the first one to insert
+ * it wins. */
+static GMutex config_cache_lock;
+static std::unordered_map<std::string, GstNvDsPostProcessConfig *>
+    config_cache;
+
+const GstNvDsPostProcessConfig *
+nvdspostprocess_config_acquire (GstNvDsPostProcess * nvdspostprocess,
+    const gchar * cfg_file_path)
+{
+  g_autoptr(GError)error = nullptr;
+  gchar canonical_path[_PATH_MAX + 1];
+  g_autofree gchar *contents = nullptr;
+  g_autofree gchar *hash = nullptr;
+  gsize length = 0;
+  GstNvDsPostProcessConfig *config = nullptr;
+  std::string key;
+
+  if (!realpath (cfg_file_path, canonical_path) ||
+      !g_file_get_contents (canonical_path, &contents, &length, &error)) {
+    GST_ELEMENT_ERROR (nvdspostprocess, LIBRARY, SETTINGS,
+        ("Failed to parse config file:%s", cfg_file_path),
+        ("%s", error ? error->message : g_strerror (errno)));
+    return nullptr;
+  }
+  hash = g_compute_checksum_for_data (G_CHECKSUM_SHA256,
+      (const guchar *) contents, length);
+  key = std::string (canonical_path) + ":" + hash;
+
+  g_mutex_lock (&config_cache_lock);
+  auto it = config_cache.find (key);
+  if (it != config_cache.end ()) {
+    it->second->refcount++;
+    g_mutex_unlock (&config_cache_lock);
+    GST_DEBUG_OBJECT (nvdspostprocess, "Sharing parsed config %s",
+        key.c_str ());
+    return it->second;
+  }
+  g_mutex_unlock (&config_cache_lock);
+
+  config = new GstNvDsPostProcessConfig;
+  config->key = key;
+  if (!nvdspostprocess_parse_config_file (nvdspostprocess, config,
+          cfg_file_path, contents, length)) {
+    nvdspostprocess_config_free (config);
+    return nullptr;
+  }
+
+  g_mutex_lock (&config_cache_lock);
+  auto inserted = config_cache.emplace (key, config);
+  if (!inserted.second) {
+    nvdspostprocess_config_free (config);
+    config = inserted.first->second;
+  }
+  config->refcount++;
+  g_mutex_unlock (&config_cache_lock);
+  return config;
+}
+
+void
+nvdspostprocess_config_release (const GstNvDsPostProcessConfig * config)
+{
+  GstNvDsPostProcessConfig *last = nullptr;
+
+  if (!config)
+    return;
+
+  g_mutex_lock (&config_cache_lock);
+  auto it = config_cache.find (config->key);
+  if (it != config_cache.end () && --it->second->refcount == 0) {
+    last = it->second;
+    config_cache.erase (it);
+  }
+  g_mutex_unlock (&config_cache_lock);
+
+  if (last)
+    nvdspostprocess_config_free (last);
+}
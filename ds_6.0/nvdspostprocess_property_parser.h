@@ -47,20 +47,36 @@
 #define NVDSPOSTPROCESS_GROUP_FCM_FACTOR "fcm_factor"
 #define NVDSPOSTPROCESS_GROUP_ZONE_CORDS "zone_cords-"
 #define NVDSPOSTPROCESS_GROUP_ZONE_APPROACH "zone_approach-"
+#define NVDSPOSTPROCESS_GROUP_ZONE_ANCHOR "zone_anchor-"
+#define NVDSPOSTPROCESS_GROUP_ZONE_MIN_OVERLAP "zone_min_overlap-"
+#define NVDSPOSTPROCESS_GROUP_ZONE_COVERAGE "zone_coverage-"
 #define NVDSPOSTPROCESS_GROUP_REMOVE_UNCOUNTED "remove_uncounted"
+#define NVDSPOSTPROCESS_GROUP_INTERVAL "interval"
+#define NVDSPOSTPROCESS_GROUP_LOW_PRIORITY "low_priority"
 
 #define NVDSPOSTPROCESS_GROUP_CUSTOM_INPUT_PREPROCESS_FUNCTION "custom-input-transformation-function"
 
 /**
- 
+ * Parsed config of @cfg_file_path, shared by every instance of the process
+ * given a file of the same canonical path and contents. The file is read and
+ * hashed on every call, it is only parsed when the cache does not have it.
  *
- * @param nvdspostprocess pointer to GstNvDsPostProcess structure
+ * @param nvdspostprocess element the parse errors are posted on
  *
  * @param cfg_file_path config file path
  *
- * @return boolean denoting if successfully parsed config file
+ * @return the config, to be given back with nvdspostprocess_config_release,
+ *         or NULL if the config file could not be read or parsed
  */
-gboolean
-nvdspostprocess_parse_config_file (GstNvDsPostProcess *nvdspostprocess, gchar *cfg_file_path);
+const GstNvDsPostProcessConfig *
+nvdspostprocess_config_acquire (GstNvDsPostProcess *nvdspostprocess,
+    const gchar *cfg_file_path);
+
+/**
+ * Drop a reference taken by nvdspostprocess_config_acquire, the last one
+ * frees the config. NULL is ignored.
+ */
+void
+nvdspostprocess_config_release (const GstNvDsPostProcessConfig *config);
 
 #endif /* NVDSPOSTPROCESS_PROPERTY_FILE_PARSER_H_ */
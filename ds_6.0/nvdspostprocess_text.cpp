@@ -0,0 +1,193 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include "nvdspostprocess_text.h"
+
+/* 5x7 glyphs in a 6x8 cell, one byte per row, bit 7 is the leftmost pixel. */
+static const uint8_t text_font_6x8[TEXT_NUM_GLYPHS][TEXT_CELL_HEIGHT] = {
+  {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},  /* ' ' */
+  {0x20, 0x20, 0x20, 0x20, 0x20, 0x00, 0x20, 0x00},  /* '!' */
+  {0x50, 0x50, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00},  /* '"' */
+  {0x50, 0x50, 0xf8, 0x50, 0xf8, 0x50, 0x50, 0x00},  /* '#' */
+  {0x20, 0x78, 0xa0, 0x70, 0x28, 0xf0, 0x20, 0x00},  /* '$' */
+  {0xc0, 0xc8, 0x10, 0x20, 0x40, 0x98, 0x18, 0x00},  /* '%' */
+  {0x60, 0x90, 0xa0, 0x40, 0xa8, 0x90, 0x68, 0x00},  /* '&' */
+  {0x20, 0x20, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00},  /* ''' */
+  {0x10, 0x20, 0x40, 0x40, 0x40, 0x20, 0x10, 0x00},  /* '(' */
+  {0x40, 0x20, 0x10, 0x10, 0x10, 0x20, 0x40, 0x00},  /* ')' */
+  {0x00, 0x20, 0xa8, 0x70, 0xa8, 0x20, 0x00, 0x00},  /* '*' */
+  {0x00, 0x20, 0x20, 0xf8, 0x20, 0x20, 0x00, 0x00},  /* '+' */
+  {0x00, 0x00, 0x00, 0x00, 0x60, 0x20, 0x40, 0x00},  /* ',' */
+  {0x00, 0x00, 0x00, 0xf8, 0x00, 0x00, 0x00, 0x00},  /* '-' */
+  {0x00, 0x00, 0x00, 0x00, 0x00, 0x60, 0x60, 0x00},  /* '.' */
+  {0x00, 0x08, 0x10, 0x20, 0x40, 0x80, 0x00, 0x00},  /* '/' */
+  {0x70, 0x88, 0x98, 0xa8, 0xc8, 0x88, 0x70, 0x00},  /* '0' */
+  {0x20, 0x60, 0x20, 0x20, 0x20, 0x20, 0x70, 0x00},  /* '1' */
+  {0x70, 0x88, 0x08, 0x10, 0x20, 0x40, 0xf8, 0x00},  /* '2' */
+  {0xf8, 0x10, 0x20, 0x10, 0x08, 0x88, 0x70, 0x00},  /* '3' */
+  {0x10, 0x30, 0x50, 0x90, 0xf8, 0x10, 0x10, 0x00},  /* '4' */
+  {0xf8, 0x80, 0xf0, 0x08, 0x08, 0x88, 0x70, 0x00},  /* '5' */
+  {0x30, 0x40, 0x80, 0xf0, 0x88, 0x88, 0x70, 0x00},  /* '6' */
+  {0xf8, 0x08, 0x10, 0x20, 0x40, 0x40, 0x40, 0x00},  /* '7' */
+  {0x70, 0x88, 0x88, 0x70, 0x88, 0x88, 0x70, 0x00},  /* '8' */
+  {0x70, 0x88, 0x88, 0x78, 0x08, 0x10, 0x60, 0x00},  /* '9' */
+  {0x00, 0x60, 0x60, 0x00, 0x60, 0x60, 0x00, 0x00},  /* ':' */
+  {0x00, 0x60, 0x60, 0x00, 0x60, 0x20, 0x40, 0x00},  /* ';' */
+  {0x10, 0x20, 0x40, 0x80, 0x40, 0x20, 0x10, 0x00},  /* '<' */
+  {0x00, 0x00, 0xf8, 0x00, 0xf8, 0x00, 0x00, 0x00},  /* '=' */
+  {0x40, 0x20, 0x10, 0x08, 0x10, 0x20, 0x40, 0x00},  /* '>' */
+  {0x70, 0x88, 0x08, 0x10, 0x20, 0x00, 0x20, 0x00},  /* '?' */
+  {0x70, 0x88, 0x08, 0x68, 0xa8, 0xa8, 0x70, 0x00},  /* '@' */
+  {0x70, 0x88, 0x88, 0x88, 0xf8, 0x88, 0x88, 0x00},  /* 'A' */
+  {0xf0, 0x88, 0x88, 0xf0, 0x88, 0x88, 0xf0, 0x00},  /* 'B' */
+  {0x70, 0x88, 0x80, 0x80, 0x80, 0x88, 0x70, 0x00},  /* 'C' */
+  {0xe0, 0x90, 0x88, 0x88, 0x88, 0x90, 0xe0, 0x00},  /* 'D' */
+  {0xf8, 0x80, 0x80, 0xf0, 0x80, 0x80, 0xf8, 0x00},  /* 'E' */
+  {0xf8, 0x80, 0x80, 0xf0, 0x80, 0x80, 0x80, 0x00},  /* 'F' */
+  {0x70, 0x88, 0x80, 0xb8, 0x88, 0x88, 0x78, 0x00},  /* 'G' */
+  {0x88, 0x88, 0x88, 0xf8, 0x88, 0x88, 0x88, 0x00},  /* 'H' */
+  {0x70, 0x20, 0x20, 0x20, 0x20, 0x20, 0x70, 0x00},  /* 'I' */
+  {0x38, 0x10, 0x10, 0x10, 0x10, 0x90, 0x60, 0x00},  /* 'J' */
+  {0x88, 0x90, 0xa0, 0xc0, 0xa0, 0x90, 0x88, 0x00},  /* 'K' */
+  {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0xf8, 0x00},  /* 'L' */
+  {0x88, 0xd8, 0xa8, 0xa8, 0x88, 0x88, 0x88, 0x00},  /* 'M' */
+  {0x88, 0x88, 0xc8, 0xa8, 0x98, 0x88, 0x88, 0x00},  /* 'N' */
+  {0x70, 0x88, 0x88, 0x88, 0x88, 0x88, 0x70, 0x00},  /* 'O' */
+  {0xf0, 0x88, 0x88, 0xf0, 0x80, 0x80, 0x80, 0x00},  /* 'P' */
+  {0x70, 0x88, 0x88, 0x88, 0xa8, 0x90, 0x68, 0x00},  /* 'Q' */
+  {0xf0, 0x88, 0x88, 0xf0, 0xa0, 0x90, 0x88, 0x00},  /* 'R' */
+  {0x78, 0x80, 0x80, 0x70, 0x08, 0x08, 0xf0, 0x00},  /* 'S' */
+  {0xf8, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x00},  /* 'T' */
+  {0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x70, 0x00},  /* 'U' */
+  {0x88, 0x88, 0x88, 0x88, 0x88, 0x50, 0x20, 0x00},  /* 'V' */
+  {0x88, 0x88, 0x88, 0xa8, 0xa8, 0xa8, 0x50, 0x00},  /* 'W' */
+  {0x88, 0x88, 0x50, 0x20, 0x50, 0x88, 0x88, 0x00},  /* 'X' */
+  {0x88, 0x88, 0x88, 0x50, 0x20, 0x20, 0x20, 0x00},  /* 'Y' */
+  {0xf8, 0x08, 0x10, 0x20, 0x40, 0x80, 0xf8, 0x00},  /* 'Z' */
+  {0x70, 0x40, 0x40, 0x40, 0x40, 0x40, 0x70, 0x00},  /* '[' */
+  {0x00, 0x80, 0x40, 0x20, 0x10, 0x08, 0x00, 0x00},  /* '\\' */
+  {0x70, 0x10, 0x10, 0x10, 0x10, 0x10, 0x70, 0x00},  /* ']' */
+  {0x20, 0x50, 0x88, 0x00, 0x00, 0x00, 0x00, 0x00},  /* '^' */
+  {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xf8, 0x00},  /* '_' */
+  {0x40, 0x20, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00},  /* '`' */
+  {0x00, 0x00, 0x70, 0x08, 0x78, 0x88, 0x78, 0x00},  /* 'a' */
+  {0x80, 0x80, 0xb0, 0xc8, 0x88, 0x88, 0xf0, 0x00},  /* 'b' */
+  {0x00, 0x00, 0x70, 0x80, 0x80, 0x88, 0x70, 0x00},  /* 'c' */
+  {0x08, 0x08, 0x68, 0x98, 0x88, 0x88, 0x78, 0x00},  /* 'd' */
+  {0x00, 0x00, 0x70, 0x88, 0xf8, 0x80, 0x70, 0x00},  /* 'e' */
+  {0x30, 0x48, 0x40, 0xe0, 0x40, 0x40, 0x40, 0x00},  /* 'f' */
+  {0x00, 0x78, 0x88, 0x88, 0x78, 0x08, 0x70, 0x00},  /* 'g' */
+  {0x80, 0x80, 0xb0, 0xc8, 0x88, 0x88, 0x88, 0x00},  /* 'h' */
+  {0x20, 0x00, 0x60, 0x20, 0x20, 0x20, 0x70, 0x00},  /* 'i' */
+  {0x10, 0x00, 0x30, 0x10, 0x10, 0x90, 0x60, 0x00},  /* 'j' */
+  {0x80, 0x80, 0x90, 0xa0, 0xc0, 0xa0, 0x90, 0x00},  /* 'k' */
+  {0x60, 0x20, 0x20, 0x20, 0x20, 0x20, 0x70, 0x00},  /* 'l' */
+  {0x00, 0x00, 0xd0, 0xa8, 0xa8, 0x88, 0x88, 0x00},  /* 'm' */
+  {0x00, 0x00, 0xb0, 0xc8, 0x88, 0x88, 0x88, 0x00},  /* 'n' */
+  {0x00, 0x00, 0x70, 0x88, 0x88, 0x88, 0x70, 0x00},  /* 'o' */
+  {0x00, 0x00, 0xf0, 0x88, 0xf0, 0x80, 0x80, 0x00},  /* 'p' */
+  {0x00, 0x00, 0x68, 0x98, 0x78, 0x08, 0x08, 0x00},  /* 'q' */
+  {0x00, 0x00, 0xb0, 0xc8, 0x80, 0x80, 0x80, 0x00},  /* 'r' */
+  {0x00, 0x00, 0x70, 0x80, 0x70, 0x08, 0xf0, 0x00},  /* 's' */
+  {0x40, 0x40, 0xe0, 0x40, 0x40, 0x48, 0x30, 0x00},  /* 't' */
+  {0x00, 0x00, 0x88, 0x88, 0x88, 0x98, 0x68, 0x00},  /* 'u' */
+  {0x00, 0x00, 0x88, 0x88, 0x88, 0x50, 0x20, 0x00},  /* 'v' */
+  {0x00, 0x00, 0x88, 0x88, 0xa8, 0xa8, 0x50, 0x00},  /* 'w' */
+  {0x00, 0x00, 0x88, 0x50, 0x20, 0x50, 0x88, 0x00},  /* 'x' */
+  {0x00, 0x00, 0x88, 0x88, 0x78, 0x08, 0x70, 0x00},  /* 'y' */
+  {0x00, 0x00, 0xf8, 0x10, 0x20, 0x40, 0xf8, 0x00},  /* 'z' */
+  {0x10, 0x20, 0x20, 0x40, 0x20, 0x20, 0x10, 0x00},  /* '{' */
+  {0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x00},  /* '|' */
+  {0x40, 0x20, 0x20, 0x10, 0x20, 0x20, 0x40, 0x00},  /* '}' */
+  {0x00, 0x00, 0x40, 0xa8, 0x10, 0x00, 0x00, 0x00},  /* '~' */
+};
+
+void
+text_atlas_init (TextAtlas *atlas, uint32_t scale)
+{
+  if (scale == 0)
+    scale = 1;
+
+  atlas->scale = scale;
+  atlas->glyph_width = TEXT_CELL_WIDTH * scale;
+  atlas->glyph_height = TEXT_CELL_HEIGHT * scale;
+  atlas->atlas.assign ((size_t) TEXT_NUM_GLYPHS * atlas->glyph_width *
+      atlas->glyph_height, 0);
+
+  for (uint32_t g = 0; g < TEXT_NUM_GLYPHS; g++) {
+    uint8_t *glyph = atlas->atlas.data () +
+        (size_t) g * atlas->glyph_width * atlas->glyph_height;
+    for (uint32_t y = 0; y < atlas->glyph_height; y++) {
+      uint8_t bits = text_font_6x8[g][y / scale];
+      for (uint32_t x = 0; x < atlas->glyph_width; x++) {
+        if (bits & (0x80 >> (x / scale)))
+          glyph[y * atlas->glyph_width + x] = 255;
+      }
+    }
+  }
+}
+
+bool
+text_label_set (TextLabel *label, const TextAtlas *atlas, const char *text)
+{
+  if (!label->mask.empty () && label->text == text)
+    return false;
+
+  size_t len = strlen (text);
+  uint32_t gw = atlas->glyph_width;
+  uint32_t gh = atlas->glyph_height;
+
+  /* assign() keeps the capacity, steady state labels never reallocate. */
+  label->text.assign (text, len);
+  label->width = (uint32_t) len * gw;
+  label->height = gh;
+  label->mask.resize ((size_t) label->width * label->height);
+
+  for (size_t i = 0; i < len; i++) {
+    unsigned char ch = (unsigned char) text[i];
+    if (ch < TEXT_FIRST_GLYPH || ch > TEXT_LAST_GLYPH)
+      ch = '?';
+    const uint8_t *glyph = atlas->atlas.data () +
+        (size_t) (ch - TEXT_FIRST_GLYPH) * gw * gh;
+    for (uint32_t y = 0; y < gh; y++)
+      memcpy (label->mask.data () + (size_t) y * label->width + i * gw,
+          glyph + (size_t) y * gw, gw);
+  }
+  return true;
+}
+
+void
+text_label_draw (OverlaySurface *surf, const TextLabel *label,
+    const TextAtlas *atlas, int32_t x, int32_t y, OverlayColor fg,
+    OverlayColor bg)
+{
+  int32_t pad = (int32_t) atlas->scale;
+
+  if (label->width == 0)
+    return;
+
+  overlay_fill_rect (surf, { x - pad, y - pad,
+      x + (int32_t) label->width + pad, y + (int32_t) label->height + pad }, bg);
+  overlay_blend_mask (surf, label->mask.data (), label->width, label->height,
+      x, y, fg);
+}
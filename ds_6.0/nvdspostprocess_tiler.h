@@ -0,0 +1,76 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __NVDSPOSTPROCESS_TILER_H__
+#define __NVDSPOSTPROCESS_TILER_H__
+
+#include <stdint.h>
+#include <vector>
+
+/**
+ * CPU RGBA resampler used to compose the batch into a single mosaic.
+ * Downscaling averages the covered source area, upscaling is bilinear.
+ * Both run as a separable fixed point filter with 8 bit weights.
+ */
+
+/** precomputed taps of one resampling direction */
+typedef struct
+{
+  uint32_t src_size;
+  uint32_t dst_size;
+  /** taps of every destination index, stride max_taps */
+  uint32_t max_taps;
+  /** first source index of every destination index */
+  std::vector<int32_t> start;
+  /** number of taps of every destination index */
+  std::vector<int32_t> count;
+  /** weights summing to 256 per destination index */
+  std::vector<uint16_t> weights;
+} TilerFilter;
+
+/** resampler state, filters are rebuilt only when the sizes change */
+typedef struct
+{
+  TilerFilter horiz;
+  TilerFilter vert;
+  /** vertically filtered source row */
+  std::vector<uint8_t> row;
+  /** source rows feeding the current destination row */
+  std::vector<const uint8_t *> rows;
+} TilerScaler;
+
+/**
+ * Resample a RGBA image into a RGBA destination rectangle.
+ */
+void tiler_scale_rgba (TilerScaler *scaler, const uint8_t *src,
+    uint32_t src_width, uint32_t src_height, uint32_t src_pitch, uint8_t *dst,
+    uint32_t dst_width, uint32_t dst_height, uint32_t dst_pitch);
+
+/** Copy a RGBA rectangle between two planes. */
+void tiler_copy_rgba (const uint8_t *src, uint32_t src_pitch, uint8_t *dst,
+    uint32_t dst_pitch, uint32_t width, uint32_t height);
+
+/** Fill a RGBA rectangle with opaque black. */
+void tiler_clear_rgba (uint8_t *dst, uint32_t dst_pitch, uint32_t width,
+    uint32_t height);
+
+#endif /* __NVDSPOSTPROCESS_TILER_H__ */
@@ -0,0 +1,237 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "nvdspostprocess_trace.h"
+
+/** period of the writer thread */
+#define TRACE_FLUSH_INTERVAL_MS 100
+
+/* Single producer single consumer ring of one recording thread. */
+typedef struct
+{
+  std::vector<TraceEvent> events;
+  uint64_t mask;
+  /** written by the recording thread */
+  alignas (64) std::atomic<uint64_t> head;
+  /** written by the writer thread */
+  alignas (64) std::atomic<uint64_t> tail;
+  uint32_t tid;
+  char thread_name[16];
+  /** thread_name metadata event already written */
+  bool named;
+} TraceRing;
+
+struct _TraceWriter
+{
+  FILE *file;
+  uint64_t id;
+  uint32_t ring_size;
+  int pid;
+  /** protects the ring list and the writer thread state */
+  std::mutex lock;
+  std::condition_variable cond;
+  std::vector<std::unique_ptr<TraceRing>> rings;
+  bool stop;
+  std::thread thread;
+  /** first event of the file, no separator before it */
+  bool first;
+  std::atomic<uint64_t> dropped;
+};
+
+/* Writers are told apart by id rather than address so that a thread never
+ * reuses the ring of a freed writer allocated at the same address. */
+static std::atomic<uint64_t> trace_writer_next_id (1);
+
+static thread_local uint64_t trace_ring_writer_id;
+static thread_local TraceRing *trace_ring;
+
+static void
+trace_write_event (TraceWriter *writer, const TraceRing *ring,
+    const TraceEvent *ev)
+{
+  FILE *f = writer->file;
+
+  fprintf (f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,"
+      "\"ts\":%lu.%03lu,\"dur\":%lu.%03lu,\"args\":{\"batch\":%lu",
+      writer->first ? "" : ",\n", ev->name, writer->pid, ring->tid,
+      (unsigned long) (ev->start_ns / 1000),
+      (unsigned long) (ev->start_ns % 1000),
+      (unsigned long) (ev->dur_ns / 1000), (unsigned long) (ev->dur_ns % 1000),
+      (unsigned long) ev->batch_num);
+  writer->first = false;
+
+  if (ev->num_frames) {
+    fprintf (f, ",\"frames\":%u,\"objects\":%u,\"sources\":[",
+        ev->num_frames, ev->num_objects);
+    for (uint32_t i = 0; i < ev->num_sources && i < TRACE_MAX_SOURCES; i++)
+      fprintf (f, "%s%u", i ? "," : "", ev->sources[i]);
+    fputc (']', f);
+  }
+  fputs ("}}", f);
+}
+
+/* Move everything recorded so far to the file. */
+static void
+trace_writer_drain (TraceWriter *writer)
+{
+  std::vector<TraceRing *> rings;
+
+  {
+    std::lock_guard<std::mutex> guard (writer->lock);
+    for (auto &ring : writer->rings)
+      rings.push_back (ring.get ());
+  }
+
+  for (TraceRing *ring : rings) {
+    uint64_t head = ring->head.load (std::memory_order_acquire);
+    uint64_t tail = ring->tail.load (std::memory_order_relaxed);
+
+    if (!ring->named) {
+      fprintf (writer->file, "%s{\"name\":\"thread_name\",\"ph\":\"M\","
+          "\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+          writer->first ? "" : ",\n", writer->pid, ring->tid,
+          ring->thread_name);
+      writer->first = false;
+      ring->named = true;
+    }
+
+    for (; tail != head; tail++)
+      trace_write_event (writer, ring, &ring->events[tail & ring->mask]);
+    ring->tail.store (tail, std::memory_order_release);
+  }
+  fflush (writer->file);
+}
+
+static void
+trace_writer_loop (TraceWriter *writer)
+{
+  std::unique_lock<std::mutex> guard (writer->lock);
+
+  while (!writer->stop) {
+    writer->cond.wait_for (guard,
+        std::chrono::milliseconds (TRACE_FLUSH_INTERVAL_MS));
+    guard.unlock ();
+    trace_writer_drain (writer);
+    guard.lock ();
+  }
+}
+
+TraceWriter *
+trace_writer_new (const char *path, uint32_t ring_size)
+{
+  FILE *file = fopen (path, "w");
+  TraceWriter *writer;
+  uint32_t size = 1;
+
+  if (!file)
+    return NULL;
+
+  while (size < ring_size)
+    size <<= 1;
+
+  writer = new TraceWriter ();
+  writer->file = file;
+  writer->id = trace_writer_next_id.fetch_add (1);
+  writer->ring_size = size;
+  writer->pid = getpid ();
+  writer->stop = false;
+  writer->first = true;
+  writer->dropped = 0;
+
+  /* JSON array format, the closing bracket is written on free. */
+  fputs ("[\n", file);
+  writer->thread = std::thread (trace_writer_loop, writer);
+  return writer;
+}
+
+/* Ring of the calling thread, created on its first event. */
+static TraceRing *
+trace_writer_thread_ring (TraceWriter *writer)
+{
+  if (trace_ring_writer_id == writer->id)
+    return trace_ring;
+
+  std::unique_ptr<TraceRing> ring (new TraceRing ());
+  ring->events.resize (writer->ring_size);
+  ring->mask = writer->ring_size - 1;
+  ring->head = 0;
+  ring->tail = 0;
+  ring->tid = (uint32_t) syscall (SYS_gettid);
+  ring->named = false;
+  if (pthread_getname_np (pthread_self (), ring->thread_name,
+          sizeof (ring->thread_name)) != 0)
+    strcpy (ring->thread_name, "unknown");
+
+  trace_ring = ring.get ();
+  trace_ring_writer_id = writer->id;
+
+  std::lock_guard<std::mutex> guard (writer->lock);
+  writer->rings.push_back (std::move (ring));
+  return trace_ring;
+}
+
+void
+trace_writer_record (TraceWriter *writer, const TraceEvent *event)
+{
+  TraceRing *ring = trace_writer_thread_ring (writer);
+  uint64_t head = ring->head.load (std::memory_order_relaxed);
+
+  if (head - ring->tail.load (std::memory_order_acquire) > ring->mask) {
+    writer->dropped.fetch_add (1, std::memory_order_relaxed);
+    return;
+  }
+  ring->events[head & ring->mask] = *event;
+  ring->head.store (head + 1, std::memory_order_release);
+}
+
+uint64_t
+trace_writer_dropped (TraceWriter *writer)
+{
+  return writer->dropped.load (std::memory_order_relaxed);
+}
+
+void
+trace_writer_free (TraceWriter *writer)
+{
+  {
+    std::lock_guard<std::mutex> guard (writer->lock);
+    writer->stop = true;
+  }
+  writer->cond.notify_one ();
+  writer->thread.join ();
+
+  trace_writer_drain (writer);
+  fputs ("\n]\n", writer->file);
+  fclose (writer->file);
+  delete writer;
+}
@@ -206,6 +206,8 @@ def main(args):
     streammux.set_property('batch-size', 1)
     #pgie.set_property('config-file-path', "dstest1_pgie_config.txt")
     nvpost.set_property('config-file', "config_postprocess.txt")
+    # draw the zones and boxes on the unified memory frames
+    nvpost.set_property('overlay', True)
 
 
 
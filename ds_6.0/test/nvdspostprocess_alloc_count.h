@@ -0,0 +1,43 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef __NVDSPOSTPROCESS_ALLOC_COUNT_H__
+#define __NVDSPOSTPROCESS_ALLOC_COUNT_H__
+
+#include <stdint.h>
+
+/**
+ * Heap allocation counter of the allocation tests. Linked into a test
+ * program, it replaces malloc and friends for the whole process (the
+ * libraries loaded by the program included, as LD_PRELOAD would) and counts
+ * the allocations made by the threads that enabled counting.
+ */
+
+/** Count the allocations of the calling thread, or stop counting them. */
+void alloc_count_enable (bool enable);
+
+/** Allocations counted since the start of the process. */
+uint64_t alloc_count_total (void);
+
+#endif /* __NVDSPOSTPROCESS_ALLOC_COUNT_H__ */
@@ -0,0 +1,129 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+
+/**
+ * Steady state allocation test of the element, make alloc-test-element.
+ * Runs nvdsfakedetect ! nvdspostprocess ! fakesink once in passthrough
+ * (enable=0) and once with the analytics path (zone test, tracks, meta
+ * attach) and counts the heap allocations made on the streaming thread
+ * between the sink pad and the src pad of nvdspostprocess, once the first
+ * TEST_WARMUP_BUFFERS buffers went through. Exits non zero if any was made.
+ */
+
+#include <stdio.h>
+#include <gst/gst.h>
+#include "nvdspostprocess_alloc_count.h"
+
+#define TEST_WARMUP_BUFFERS 500
+#define TEST_BUFFERS 2000
+
+typedef struct
+{
+  guint buffers;
+} TestCounter;
+
+static GstPadProbeReturn
+test_sink_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  TestCounter *counter = (TestCounter *) user_data;
+
+  if (++counter->buffers > TEST_WARMUP_BUFFERS)
+    alloc_count_enable (true);
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn
+test_src_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  alloc_count_enable (false);
+  return GST_PAD_PROBE_OK;
+}
+
+/* Runs the pipeline to EOS, returns the allocations counted or -1. */
+static gint64
+test_run (const gchar * config_file, gboolean enable)
+{
+  TestCounter counter = { 0 };
+  GError *error = NULL;
+  gchar *description = g_strdup_printf ("nvdsfakedetect num-sources=8 "
+      "objects-per-frame=100 num-buffers=%u ! nvdspostprocess name=pp "
+      "config-file=%s enable=%d stats=0 async=0 ! fakesink sync=0",
+      TEST_BUFFERS, config_file, enable);
+  GstElement *pipeline = gst_parse_launch (description, &error);
+  g_free (description);
+  if (!pipeline) {
+    fprintf (stderr, "pipeline: %s\n", error->message);
+    g_error_free (error);
+    return -1;
+  }
+
+  GstElement *pp = gst_bin_get_by_name (GST_BIN (pipeline), "pp");
+  GstPad *sink = gst_element_get_static_pad (pp, "sink");
+  GstPad *src = gst_element_get_static_pad (pp, "src");
+  gst_pad_add_probe (sink, GST_PAD_PROBE_TYPE_BUFFER, test_sink_probe,
+      &counter, NULL);
+  gst_pad_add_probe (src, GST_PAD_PROBE_TYPE_BUFFER, test_src_probe,
+      NULL, NULL);
+  gst_object_unref (sink);
+  gst_object_unref (src);
+  gst_object_unref (pp);
+
+  uint64_t before = alloc_count_total ();
+  gint64 allocations = -1;
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  GstBus *bus = gst_element_get_bus (pipeline);
+  GstMessage *msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      (GstMessageType) (GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS) {
+    allocations = alloc_count_total () - before;
+  } else {
+    gst_message_parse_error (msg, &error, NULL);
+    fprintf (stderr, "pipeline: %s\n", error->message);
+    g_error_free (error);
+  }
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+  return allocations;
+}
+
+int
+main (int argc, char *argv[])
+{
+  const gchar *config_file = argc > 1 ? argv[1] : "config_postprocess.txt";
+  int failed = 0;
+
+  gst_init (&argc, &argv);
+  for (int enable = 0; enable <= 1; enable++) {
+    gint64 allocations = test_run (config_file, enable);
+    printf ("%s: %" G_GINT64_FORMAT " allocations in %u buffers after "
+        "warm-up\n", enable ? "analytics" : "passthrough", allocations,
+        TEST_BUFFERS - TEST_WARMUP_BUFFERS);
+    if (allocations != 0)
+      failed = 1;
+  }
+  return failed;
+}
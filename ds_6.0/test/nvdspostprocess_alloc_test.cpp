@@ -0,0 +1,227 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+
+/**
+ * Steady state allocation test, make alloc-test. Runs the per batch path of
+ * the element over the core library (gather into the scratch arena, zone
+ * test, track update and extrapolation, counters, histograms, overlay with
+ * count labels, tiler and heatmap) on a synthetic stream with moving,
+ * appearing and disappearing objects. Once warmed up, no batch may touch
+ * the heap.
+ */
+
+#include <stdio.h>
+#include <vector>
+#include <gtest/gtest.h>
+#include "nvdspostprocess_alloc_count.h"
+#include "nvdspostprocess_analytics.h"
+#include "nvdspostprocess_arena.h"
+#include "nvdspostprocess_heatmap.h"
+#include "nvdspostprocess_overlay.h"
+#include "nvdspostprocess_stats.h"
+#include "nvdspostprocess_text.h"
+#include "nvdspostprocess_tiler.h"
+
+#define TEST_SOURCES 4
+#define TEST_OBJECTS_PER_FRAME 100
+#define TEST_OBJECT_LIFETIME 150
+#define TEST_FRAME_WIDTH 640
+#define TEST_FRAME_HEIGHT 360
+#define TEST_WARMUP_BATCHES 1000
+#define TEST_STEADY_BATCHES 500
+
+/* What the element keeps per source, the zones are shared. */
+typedef struct
+{
+  AnalyticsSource analytics;
+  std::vector<TextLabel> zone_labels;
+  Heatmap heatmap;
+  std::vector<uint8_t> frame;
+  /** analyse every interval-th frame */
+  uint32_t interval;
+} TestSource;
+
+/* Synthetic tracked detections: object i of a source moves on a line and
+ * is replaced by a new object id every TEST_OBJECT_LIFETIME frames, at a
+ * phase of its own so that tracks come and go on every frame. */
+static void
+test_detection (uint32_t source, uint32_t i, uint64_t frame, float *left,
+    float *top, uint64_t *object_id)
+{
+  uint64_t phase = frame + i * 7;
+  uint64_t life = phase / TEST_OBJECT_LIFETIME;
+  float t = (float) (phase % TEST_OBJECT_LIFETIME) / TEST_OBJECT_LIFETIME;
+
+  *left = (i * 37 % (TEST_FRAME_WIDTH - 40)) * (1 - t) + t * (i * 13 % 200);
+  *top = (i * 53 % (TEST_FRAME_HEIGHT - 60)) * (1 - t) + t * 280;
+  *object_id = ((uint64_t) source << 48) | (life << 16) | i;
+}
+
+/* Keeps the compiler from eliding the allocations below. */
+static void *volatile test_escape;
+
+TEST (Allocations, CounterSeesHeap)
+{
+  uint64_t before = alloc_count_total ();
+
+  alloc_count_enable (true);
+  std::vector<int> *v = new std::vector<int> (16);
+  test_escape = v;
+  void *p = malloc (32);
+  test_escape = p;
+  alloc_count_enable (false);
+  free (p);
+  delete v;
+  EXPECT_EQ (alloc_count_total () - before, 3u);
+}
+
+TEST (Allocations, SteadyStateBatchPath)
+{
+  std::vector<AnalyticsZone> zones = {
+    {{20, 20}, {300, 30}, {320, 200}, {150, 300}, {10, 250}},
+    {{330, 20}, {620, 20}, {620, 340}, {330, 340}}};
+  static LatencyHistogram stage_latency;
+  SourceCounters counters[TEST_SOURCES] = {};
+  AnalyticsZoneSet zone_set = {};
+  std::vector<OverlayPolygon> overlay_zones;
+  TestSource sources[TEST_SOURCES];
+  std::vector<uint8_t> mosaic (TEST_FRAME_WIDTH * TEST_FRAME_HEIGHT * 4);
+  ScratchArena arena = {};
+  OverlaySurface surf = {};
+  OverlayScratch overlay_scratch;
+  TextAtlas atlas;
+  TilerScaler scaler = {};
+  uint64_t before = 0;
+
+  ASSERT_TRUE (arena_init (&arena, ARENA_MIN_SIZE));
+  text_atlas_init (&atlas, 2);
+  latency_histogram_reset (&stage_latency);
+  analytics_zone_set_init (&zone_set, zones);
+  analytics_zone_set_anchor (&zone_set, 1, {ANALYTICS_ANCHOR_OVERLAP, 0.5});
+  analytics_zone_set_coverage (&zone_set, 0, true);
+  for (const AnalyticsZone &zone : zones) {
+    OverlayPolygon poly;
+    for (const AnalyticsPoint &pt : zone)
+      poly.pts.push_back ({(int32_t) pt.x, (int32_t) pt.y});
+    poly.border = {255, 0, 0, 255};
+    overlay_compile_polygon (&poly);
+    overlay_zones.push_back (poly);
+  }
+  for (uint32_t s = 0; s < TEST_SOURCES; s++) {
+    TestSource &src = sources[s];
+    src.analytics = {};
+    analytics_source_init (&src.analytics, &zone_set);
+    src.zone_labels.assign (zones.size (), TextLabel ());
+    heatmap_init (&src.heatmap, 64, 36, 300);
+    src.frame.assign (TEST_FRAME_WIDTH * TEST_FRAME_HEIGHT * 4, 0);
+    src.interval = s % 2 ? 3 : 1;
+  }
+
+  for (uint64_t b = 0; b < TEST_WARMUP_BATCHES + TEST_STEADY_BATCHES; b++) {
+    size_t n = TEST_SOURCES * TEST_OBJECTS_PER_FRAME;
+
+    if (b == TEST_WARMUP_BATCHES) {
+      before = alloc_count_total ();
+      alloc_count_enable (true);
+    }
+    uint64_t start = latency_now_ns ();
+
+    /* Gather, columns from the arena as in the element. */
+    arena_reset (&arena);
+    AnalyticsObjects objects = {
+      arena_alloc_array<float> (&arena, n),
+      arena_alloc_array<float> (&arena, n),
+      arena_alloc_array<float> (&arena, n),
+      arena_alloc_array<float> (&arena, n),
+      arena_alloc_array<uint64_t> (&arena, n),
+      arena_alloc_array<uint8_t> (&arena, n),
+      arena_alloc_array<uint64_t> (&arena, n)};
+
+    for (uint32_t s = 0; s < TEST_SOURCES; s++) {
+      TestSource &src = sources[s];
+      size_t first = s * TEST_OBJECTS_PER_FRAME;
+      AnalyticsObjects frame_objects =
+          analytics_objects_slice (objects, first);
+      char text[64];
+
+      source_counters_add_frame (&counters[s], start);
+      for (uint32_t i = 0; i < TEST_OBJECTS_PER_FRAME; i++) {
+        size_t k = first + i;
+        test_detection (s, i, b, (float *) &objects.left[k],
+            (float *) &objects.top[k], (uint64_t *) &objects.object_id[k]);
+        ((float *) objects.width)[k] = 30;
+        ((float *) objects.height)[k] = 50;
+        ((uint8_t *) objects.counted)[k] = i % 5 != 0;
+      }
+
+      if (b % src.interval) {
+        analytics_extrapolate_frame (&src.analytics);
+      } else {
+        analytics_test_zones (&src.analytics, &frame_objects,
+            TEST_OBJECTS_PER_FRAME);
+        analytics_update_tracks (&src.analytics, &frame_objects,
+            TEST_OBJECTS_PER_FRAME);
+        heatmap_add_frame (&src.heatmap, &frame_objects,
+            TEST_OBJECTS_PER_FRAME, TEST_FRAME_WIDTH, TEST_FRAME_HEIGHT);
+      }
+
+      overlay_begin_frame (&surf, src.frame.data (), TEST_FRAME_WIDTH,
+          TEST_FRAME_HEIGHT, TEST_FRAME_WIDTH * 4);
+      for (size_t z = 0; z < overlay_zones.size (); z++) {
+        const OverlayPolygon &poly = overlay_zones[z];
+        overlay_fill_polygon (&surf, &poly, {255, 0, 0, 76},
+            &overlay_scratch);
+        overlay_draw_polygon (&surf, &poly, 2);
+        snprintf (text, sizeof (text), "Zone %zu: %llu", z,
+            (unsigned long long) src.analytics.entries[z]);
+        text_label_set (&src.zone_labels[z], &atlas, text);
+        text_label_draw (&surf, &src.zone_labels[z], &atlas,
+            poly.bounds.left, poly.bounds.top, {255, 255, 255, 255},
+            {0, 0, 0, 160});
+      }
+      for (uint32_t i = 0; i < TEST_OBJECTS_PER_FRAME; i++) {
+        size_t k = first + i;
+        overlay_draw_rect (&surf, {(int32_t) objects.left[k],
+                (int32_t) objects.top[k], (int32_t) objects.left[k] + 30,
+                (int32_t) objects.top[k] + 50}, 2, {0, 255, 0, 255});
+      }
+
+      tiler_scale_rgba (&scaler, src.frame.data (), TEST_FRAME_WIDTH,
+          TEST_FRAME_HEIGHT, TEST_FRAME_WIDTH * 4,
+          mosaic.data () + (s % 2) * TEST_FRAME_WIDTH * 2 +
+          (s / 2) * TEST_FRAME_HEIGHT / 2 * TEST_FRAME_WIDTH * 4,
+          TEST_FRAME_WIDTH / 2, TEST_FRAME_HEIGHT / 2, TEST_FRAME_WIDTH * 4);
+    }
+    latency_histogram_record (&stage_latency, latency_now_ns () - start);
+  }
+  alloc_count_enable (false);
+
+  EXPECT_EQ (alloc_count_total () - before, 0u)
+      << "heap allocations in " << TEST_STEADY_BATCHES
+      << " batches after warm-up";
+  /* The stream did count, so the path under test was not trivial. */
+  EXPECT_GT (sources[0].analytics.entries[0], 0u);
+  arena_free (&arena);
+}
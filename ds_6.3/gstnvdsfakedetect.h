@@ -0,0 +1,146 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef __GST_NVDSFAKEDETECT_H__
+#define __GST_NVDSFAKEDETECT_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstbasesrc.h>
+#include <gst/video/video.h>
+
+#include <vector>
+#include "nvbufsurface.h"
+#include "gstnvdsmeta.h"
+#include "nvdspostprocess_record.h"
+
+G_BEGIN_DECLS
+/* Standard boilerplate stuff */
+typedef struct _GstNvDsFakeDetect GstNvDsFakeDetect;
+typedef struct _GstNvDsFakeDetectClass GstNvDsFakeDetectClass;
+
+/* Standard boilerplate stuff */
+#define GST_TYPE_NVDSFAKEDETECT (gst_nvdsfakedetect_get_type())
+#define GST_NVDSFAKEDETECT(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_NVDSFAKEDETECT,GstNvDsFakeDetect))
+#define GST_NVDSFAKEDETECT_CLASS(klass) (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_NVDSFAKEDETECT,GstNvDsFakeDetectClass))
+#define GST_IS_NVDSFAKEDETECT(obj) (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_NVDSFAKEDETECT))
+#define GST_NVDSFAKEDETECT_CAST(obj)  ((GstNvDsFakeDetect *)(obj))
+
+/** how the synthetic objects move between frames */
+typedef enum
+{
+  /** boxes stay where they spawned */
+  NVDSFAKEDETECT_MOTION_STATIC,
+  /** constant velocity, bouncing on the frame borders */
+  NVDSFAKEDETECT_MOTION_LINEAR,
+  /** velocity perturbed every frame */
+  NVDSFAKEDETECT_MOTION_RANDOM_WALK
+} GstNvDsFakeDetectMotion;
+
+/** synthetic detection, one per object slot of a source */
+typedef struct
+{
+  /** box, in pixels of the frame */
+  gfloat left, top, width, height;
+  /** pixels per frame */
+  gfloat vx, vy;
+  gint class_id;
+  /** track id, unique across sources */
+  guint64 object_id;
+  /** frames left before the object is replaced, 0 lives forever */
+  guint frames_left;
+} GstNvDsFakeDetectObject;
+
+/** entry of the class mix */
+typedef struct
+{
+  gint class_id;
+  /** cumulative weight, the last entry holds the total */
+  gdouble cumulative;
+} GstNvDsFakeDetectClassWeight;
+
+struct _GstNvDsFakeDetect
+{
+  /** Gst Base Source */
+  GstBaseSrc base_src;
+
+  /** frames per batch, source ids are 0 .. num_sources - 1 */
+  guint num_sources;
+
+  /** resolution of the surfaces */
+  guint width;
+  guint height;
+
+  /** frame rate of the timestamps */
+  guint fps;
+
+  /** pace the batches on the clock instead of producing them at once */
+  gboolean is_live;
+
+  /** objects attached to every frame */
+  guint objects_per_frame;
+
+  /** mean frames an object lives before being replaced by a new track */
+  guint object_lifetime;
+
+  /** motion model and mean speed in pixels per frame */
+  GstNvDsFakeDetectMotion motion;
+  gdouble speed;
+
+  /** class mix as "class:weight,class:weight" */
+  gchar *class_mix;
+  std::vector<GstNvDsFakeDetectClassWeight> class_weights;
+
+  /** random seed, runs with the same seed produce the same metadata */
+  guint seed;
+  guint64 rng_state;
+
+  /** num_sources * objects_per_frame objects, source major */
+  std::vector<GstNvDsFakeDetectObject> objects;
+  guint64 next_object_id;
+
+  /** nvdspostprocess record-file played back instead of the generator */
+  gchar *replay_file;
+  RecordReader *replay_reader;
+  /** pts of the first recorded batch, replayed batches start at 0 */
+  guint64 replay_first_pts;
+
+  /** frames per batch, num_sources or the largest recorded batch */
+  guint batch_size;
+
+  /** batches produced since start */
+  guint64 frame_num;
+
+  /** surfaces already cleared, pool buffers come uninitialized */
+  std::vector<void *> cleared_surfaces;
+};
+
+/* Boiler plate stuff */
+struct _GstNvDsFakeDetectClass
+{
+  GstBaseSrcClass parent_class;
+};
+
+GType gst_nvdsfakedetect_get_type (void);
+
+G_END_DECLS
+#endif /* __GST_NVDSFAKEDETECT_H__ */
@@ -0,0 +1,115 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <dirent.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include "nvdspostprocess_affinity.h"
+
+bool
+affinity_parse_cpus (const char *list, std::vector<int> *cpus)
+{
+  const char *p = list;
+
+  cpus->clear ();
+  while (*p) {
+    char *end;
+    long first, last;
+
+    errno = 0;
+    first = strtol (p, &end, 10);
+    if (end == p || errno || first < 0 || first >= CPU_SETSIZE)
+      return false;
+    last = first;
+    p = end;
+    if (*p == '-') {
+      last = strtol (++p, &end, 10);
+      if (end == p || errno || last < first || last >= CPU_SETSIZE)
+        return false;
+      p = end;
+    }
+    for (long cpu = first; cpu <= last; cpu++)
+      cpus->push_back ((int) cpu);
+    if (*p == ',')
+      p++;
+    else if (*p)
+      return false;
+  }
+
+  std::sort (cpus->begin (), cpus->end ());
+  cpus->erase (std::unique (cpus->begin (), cpus->end ()), cpus->end ());
+  return !cpus->empty ();
+}
+
+int
+affinity_cpu_node (int cpu)
+{
+  char path[64];
+  DIR *dir;
+  struct dirent *entry;
+  int node = 0;
+
+  /* The cpu directory links to its node as nodeN. */
+  snprintf (path, sizeof (path), "/sys/devices/system/cpu/cpu%d", cpu);
+  if (!(dir = opendir (path)))
+    return 0;
+  while ((entry = readdir (dir))) {
+    if (!strncmp (entry->d_name, "node", 4) && entry->d_name[4] >= '0' &&
+        entry->d_name[4] <= '9') {
+      node = atoi (entry->d_name + 4);
+      break;
+    }
+  }
+  closedir (dir);
+  return node;
+}
+
+std::vector<std::vector<int>>
+affinity_split_by_node (const std::vector<int> &cpus)
+{
+  std::map<int, std::vector<int>> nodes;
+  std::vector<std::vector<int>> sets;
+
+  for (int cpu : cpus)
+    nodes[affinity_cpu_node (cpu)].push_back (cpu);
+  for (auto &node : nodes)
+    sets.push_back (std::move (node.second));
+  return sets;
+}
+
+bool
+affinity_pin_current_thread (const std::vector<int> &cpus)
+{
+  cpu_set_t set;
+
+  CPU_ZERO (&set);
+  for (int cpu : cpus)
+    CPU_SET (cpu, &set);
+  /* pid 0 is the calling thread, not the whole process. */
+  return sched_setaffinity (0, sizeof (set), &set) == 0;
+}
@@ -0,0 +1,60 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef __NVDSPOSTPROCESS_AFFINITY_H__
+#define __NVDSPOSTPROCESS_AFFINITY_H__
+
+#include <vector>
+
+/**
+ * CPU sets of the worker threads. Only threads are pinned, memory is not
+ * bound to a NUMA node. With the default local allocation policy, state a
+ * pinned thread allocates and fills itself usually ends up on its node.
+ */
+
+/**
+ * Parse a CPU list such as "0-7,16,18-19" into sorted, unique CPU numbers.
+ *
+ * @return false if the list is malformed or empty
+ */
+bool affinity_parse_cpus (const char *list, std::vector<int> *cpus);
+
+/** NUMA node of @cpu from sysfs, 0 when it can't be told. */
+int affinity_cpu_node (int cpu);
+
+/**
+ * Split @cpus into one set per NUMA node, nodes in increasing order. The
+ * threads of a pool are spread over the sets round robin, so that each
+ * thread stays on one node while the scheduler balances it inside it.
+ */
+std::vector<std::vector<int>> affinity_split_by_node (
+    const std::vector<int> &cpus);
+
+/**
+ * Restrict the calling thread to @cpus.
+ *
+ * @return false if the kernel refused the set, the thread is left as it was
+ */
+bool affinity_pin_current_thread (const std::vector<int> &cpus);
+
+#endif /* __NVDSPOSTPROCESS_AFFINITY_H__ */
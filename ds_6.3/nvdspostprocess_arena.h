@@ -0,0 +1,93 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef __NVDSPOSTPROCESS_ARENA_H__
+#define __NVDSPOSTPROCESS_ARENA_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Bump allocator for the scratch of one batch. An allocation is a pointer
+ * increment into a single block and everything is released at once by
+ * arena_reset. Requests a batch makes beyond the block are served from
+ * overflow blocks, and the block is then resized at the next reset from
+ * the high-water mark of the recent batches, so that it grows to the
+ * stream and shrinks back after a burst.
+ */
+
+/** smallest block, in bytes */
+#define ARENA_MIN_SIZE (64 << 10)
+
+/** batches over which the high-water mark is kept before the block may
+ * shrink */
+#define ARENA_SHRINK_WINDOW 1024
+
+typedef struct _ArenaOverflow ArenaOverflow;
+
+typedef struct
+{
+  uint8_t *block;
+  size_t size;
+  /** bytes of the block handed out in this batch */
+  size_t used;
+  /** blocks allocated when the block was full, freed by arena_reset */
+  ArenaOverflow *overflow;
+  size_t overflow_bytes;
+  /** largest batch of the current shrink window */
+  size_t high_water;
+  uint32_t window_batches;
+} ScratchArena;
+
+/**
+ * Allocate the block.
+ *
+ * @return false if @size bytes could not be allocated
+ */
+bool arena_init (ScratchArena *arena, size_t size);
+
+/**
+ * @size bytes aligned on @align, a power of 2 up to 64, valid until the next
+ * arena_reset. Never fails short of the process running out of memory.
+ */
+void *arena_alloc (ScratchArena *arena, size_t size, size_t align);
+
+/** Array of @n T, uninitialized. */
+template <typename T> static inline T *
+arena_alloc_array (ScratchArena *arena, size_t n)
+{
+  return (T *) arena_alloc (arena, n * sizeof (T), alignof (T));
+}
+
+/**
+ * Release everything allocated since the last reset and resize the block
+ * if needed.
+ *
+ * @return bytes the batch allocated, alignment included
+ */
+size_t arena_reset (ScratchArena *arena);
+
+/** Free the block and the overflow blocks. */
+void arena_free (ScratchArena *arena);
+
+#endif /* __NVDSPOSTPROCESS_ARENA_H__ */
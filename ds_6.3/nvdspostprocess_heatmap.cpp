@@ -0,0 +1,292 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "nvdspostprocess_heatmap.h"
+
+/** weight past which the cells are rescaled, far from the float range */
+#define HEATMAP_MAX_WEIGHT 4294967296.0f
+
+/* Map of a source as written, already divided by the weight. */
+typedef struct
+{
+  uint32_t source_id;
+  uint32_t columns;
+  uint32_t rows;
+  std::vector<float> values;
+} HeatmapSnapshot;
+
+struct _HeatmapWriter
+{
+  std::string dir;
+  /** protects the handover below, not the buffers being filled or written */
+  std::mutex lock;
+  std::condition_variable cond;
+  /** filled by heatmap_writer_add, producer only */
+  std::vector<HeatmapSnapshot> front;
+  size_t front_count;
+  /** being written by the writer thread, 0 maps when it is idle */
+  std::vector<HeatmapSnapshot> back;
+  size_t back_count;
+  bool stop;
+  std::thread thread;
+  std::atomic<uint64_t> skipped;
+  /** snapshots with a map that could not be written */
+  std::atomic<uint64_t> failed;
+  /** file contents, writer thread only */
+  std::vector<uint8_t> file;
+};
+
+void
+heatmap_init (Heatmap *map, uint32_t columns, uint32_t rows, double half_life)
+{
+  map->columns = std::max (columns, 1u);
+  map->rows = std::max (rows, 1u);
+  map->cells.assign ((size_t) map->columns * map->rows + 1, 0);
+  map->weight = 1;
+  map->growth = half_life > 0 ? (float) pow (2.0, 1.0 / half_life) : 1;
+  map->index.clear ();
+  map->frames = 0;
+}
+
+void
+heatmap_add_frame (Heatmap *map, const AnalyticsObjects *objects,
+    size_t num_objects, float frame_width, float frame_height)
+{
+  uint32_t columns = map->columns, rows = map->rows;
+  uint32_t outside = columns * rows;
+  float scale_x = frame_width > 0 ? columns / frame_width : 0;
+  float scale_y = frame_height > 0 ? rows / frame_height : 0;
+
+  map->frames++;
+  map->weight *= map->growth;
+  if (map->weight > HEATMAP_MAX_WEIGHT) {
+    float scale = 1 / map->weight;
+    for (float &cell : map->cells)
+      cell *= scale;
+    map->weight = 1;
+  }
+
+  if (map->index.size () < num_objects)
+    map->index.resize (num_objects);
+  uint32_t *index = map->index.data ();
+
+  /* Cell of every object first, over contiguous arrays and without
+   * branches, the objects that don't count going to the extra cell. The
+   * bottom centre of a box resting on the frame border is in the last
+   * row. */
+  for (size_t k = 0; k < num_objects; k++) {
+    float x = (objects->left[k] + objects->width[k] / 2) * scale_x;
+    float y = (objects->top[k] + objects->height[k]) * scale_y;
+    bool in = (objects->counted[k] != 0) & (x >= 0) & (x <= columns) &
+        (y >= 0) & (y <= rows);
+    uint32_t column = std::min ((uint32_t) std::max (x, 0.0f), columns - 1);
+    uint32_t row = std::min ((uint32_t) std::max (y, 0.0f), rows - 1);
+    index[k] = in ? row * columns + column : outside;
+  }
+
+  /* Then the scatter, objects sharing a cell add up. */
+  float weight = map->weight;
+  float *cells = map->cells.data ();
+  for (size_t k = 0; k < num_objects; k++)
+    cells[index[k]] += weight;
+}
+
+static bool
+heatmap_write_all (int fd, const uint8_t *data, size_t size)
+{
+  while (size) {
+    ssize_t written = write (fd, data, size);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    data += written;
+    size -= written;
+  }
+  return true;
+}
+
+/* Write @snapshot as a little endian PFM, bottom row first as the format
+ * wants, through a temporary file renamed over the previous map. */
+static bool
+heatmap_write_snapshot (HeatmapWriter *writer,
+    const HeatmapSnapshot &snapshot)
+{
+  char header[64], name[64];
+  int header_size = snprintf (header, sizeof (header), "Pf\n%u %u\n-1.0\n",
+      snapshot.columns, snapshot.rows);
+  size_t row_size = snapshot.columns * sizeof (float);
+  bool ok;
+  int fd;
+
+  writer->file.resize (header_size + row_size * snapshot.rows);
+  std::copy (header, header + header_size, writer->file.begin ());
+  for (uint32_t r = 0; r < snapshot.rows; r++) {
+    const float *row = &snapshot.values[(size_t) r * snapshot.columns];
+    std::copy ((const uint8_t *) row, (const uint8_t *) row + row_size,
+        writer->file.begin () + header_size +
+        (snapshot.rows - 1 - r) * row_size);
+  }
+
+  snprintf (name, sizeof (name), HEATMAP_FILE_FORMAT, snapshot.source_id);
+  std::string path = writer->dir + "/" + name;
+  std::string tmp_path = path + ".tmp";
+
+  fd = open (tmp_path.c_str (), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+      0644);
+  if (fd < 0)
+    return false;
+  ok = heatmap_write_all (fd, writer->file.data (), writer->file.size ());
+  ok = (close (fd) == 0) && ok;
+  ok = ok && rename (tmp_path.c_str (), path.c_str ()) == 0;
+  if (!ok)
+    unlink (tmp_path.c_str ());
+  return ok;
+}
+
+static void
+heatmap_writer_loop (HeatmapWriter *writer)
+{
+  std::unique_lock<std::mutex> guard (writer->lock);
+
+  for (;;) {
+    writer->cond.wait (guard, [writer] {
+          return writer->back_count || writer->stop;
+        });
+    if (!writer->back_count)
+      break;
+
+    bool ok = true;
+    guard.unlock ();
+    for (size_t i = 0; i < writer->back_count; i++)
+      ok = heatmap_write_snapshot (writer, writer->back[i]) && ok;
+    if (!ok)
+      writer->failed.fetch_add (1, std::memory_order_relaxed);
+    guard.lock ();
+    writer->back_count = 0;
+  }
+}
+
+HeatmapWriter *
+heatmap_writer_new (const char *dir)
+{
+  HeatmapWriter *writer;
+  struct stat st;
+
+  if (stat (dir, &st) < 0)
+    return NULL;
+  if (!S_ISDIR (st.st_mode)) {
+    errno = ENOTDIR;
+    return NULL;
+  }
+  if (access (dir, W_OK) < 0)
+    return NULL;
+
+  writer = new HeatmapWriter ();
+  writer->dir = dir;
+  writer->front_count = 0;
+  writer->back_count = 0;
+  writer->stop = false;
+  writer->thread = std::thread (heatmap_writer_loop, writer);
+  return writer;
+}
+
+void
+heatmap_writer_add (HeatmapWriter *writer, uint32_t source_id,
+    const Heatmap *map)
+{
+  size_t num_cells = (size_t) map->columns * map->rows;
+  float scale = 1 / map->weight;
+
+  if (writer->front.size () <= writer->front_count)
+    writer->front.emplace_back ();
+  HeatmapSnapshot &snapshot = writer->front[writer->front_count++];
+  snapshot.source_id = source_id;
+  snapshot.columns = map->columns;
+  snapshot.rows = map->rows;
+  snapshot.values.resize (num_cells);
+  for (size_t i = 0; i < num_cells; i++)
+    snapshot.values[i] = map->cells[i] * scale;
+}
+
+void
+heatmap_writer_commit (HeatmapWriter *writer)
+{
+  std::lock_guard<std::mutex> guard (writer->lock);
+
+  if (!writer->front_count)
+    return;
+  if (writer->back_count) {
+    writer->skipped.fetch_add (1, std::memory_order_relaxed);
+  } else {
+    writer->front.swap (writer->back);
+    writer->back_count = writer->front_count;
+    writer->cond.notify_one ();
+  }
+  writer->front_count = 0;
+}
+
+uint64_t
+heatmap_writer_skipped (HeatmapWriter *writer)
+{
+  return writer->skipped.load (std::memory_order_relaxed);
+}
+
+uint64_t
+heatmap_writer_free (HeatmapWriter *writer)
+{
+  uint64_t lost;
+
+  {
+    std::lock_guard<std::mutex> guard (writer->lock);
+    writer->stop = true;
+    writer->cond.notify_one ();
+  }
+  writer->thread.join ();
+
+  /* The thread has written the committed snapshot, the one added since is
+   * written here rather than dropped. */
+  bool ok = true;
+  for (size_t i = 0; i < writer->front_count; i++)
+    ok = heatmap_write_snapshot (writer, writer->front[i]) && ok;
+  if (!ok)
+    writer->failed.fetch_add (1, std::memory_order_relaxed);
+  lost = writer->skipped.load (std::memory_order_relaxed) +
+      writer->failed.load (std::memory_order_relaxed);
+  delete writer;
+  return lost;
+}
@@ -0,0 +1,123 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+
+#ifndef __NVDSPOSTPROCESS_HEATMAP_H__
+#define __NVDSPOSTPROCESS_HEATMAP_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "nvdspostprocess_analytics.h"
+
+/**
+ * Per source heatmaps of where the counted objects stand, and their
+ * asynchronous export.
+ *
+ * A heatmap is a grid of columns x rows cells over the frame, each counted
+ * object adds to the cell of its bottom centre. With a decay, older frames
+ * fade out with a half-life in analysed frames. The decay is not applied
+ * to the cells: every frame adds with a weight growing by 1 / decay and a
+ * snapshot divides by the current weight, the cells only being rescaled
+ * when the weight gets large.
+ *
+ * Snapshots are written as PFM (portable float map) files, one per source,
+ * by a writer thread. Each file is written under a temporary name then
+ * renamed, so a reader never sees a partial map. A directory on a tmpfs such
+ * as /dev/shm keeps the maps in shared memory.
+ */
+
+/** file name of the map of a source in the export directory */
+#define HEATMAP_FILE_FORMAT "source-%u.pfm"
+
+typedef struct
+{
+  uint32_t columns;
+  uint32_t rows;
+  /** cells in row major order, plus one cell taking the objects that are
+   * not counted or outside the frame so that the adds need no branch */
+  std::vector<float> cells;
+  /** weight of the next frame */
+  float weight;
+  /** 1 / decay per frame, 1 without decay */
+  float growth;
+  /** per object cell indices of the frame being added */
+  std::vector<uint32_t> index;
+  /** frames added since the heatmap was initialized */
+  uint64_t frames;
+} Heatmap;
+
+typedef struct _HeatmapWriter HeatmapWriter;
+
+/**
+ * Set the size of @map and clear it.
+ *
+ * @param half_life analysed frames after which an object weighs half, 0
+ *   accumulates without decay
+ */
+void heatmap_init (Heatmap *map, uint32_t columns, uint32_t rows,
+    double half_life);
+
+/**
+ * Add the bottom centres of the counted @objects of a frame of
+ * @frame_width x @frame_height pixels.
+ */
+void heatmap_add_frame (Heatmap *map, const AnalyticsObjects *objects,
+    size_t num_objects, float frame_width, float frame_height);
+
+/**
+ * Start the writer thread of the maps exported to @dir.
+ *
+ * @return NULL with errno set if @dir is not a writable directory
+ */
+HeatmapWriter *heatmap_writer_new (const char *dir);
+
+/**
+ * Copy the map of @source_id into the snapshot being assembled. Only
+ * copies, the files are written once the snapshot is committed.
+ */
+void heatmap_writer_add (HeatmapWriter *writer, uint32_t source_id,
+    const Heatmap *map);
+
+/**
+ * Hand the snapshot to the writer thread. Never waits for the disk: if the
+ * previous snapshot is still being written this one is skipped, the next
+ * one holds the same frames and more.
+ */
+void heatmap_writer_commit (HeatmapWriter *writer);
+
+/** Snapshots skipped because the previous one was still being written. */
+uint64_t heatmap_writer_skipped (HeatmapWriter *writer);
+
+/**
+ * Wait for the committed snapshot to be written, stop the thread, then
+ * write the snapshot added since the last commit, if any. Adding the maps
+ * without committing before freeing the writer therefore always writes
+ * them, even when the thread is busy.
+ *
+ * @return snapshots skipped or not written because of an error
+ */
+uint64_t heatmap_writer_free (HeatmapWriter *writer);
+
+#endif /* __NVDSPOSTPROCESS_HEATMAP_H__ */
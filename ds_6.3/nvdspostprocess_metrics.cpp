@@ -0,0 +1,216 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <thread>
+#include "nvdspostprocess_metrics.h"
+
+/** a scrape that doesn't send its request in time is dropped */
+#define METRICS_REQUEST_TIMEOUT_MS 1000
+#define METRICS_MAX_REQUEST 4096
+
+struct _MetricsServer
+{
+  int listen_fd;
+  /** written to stop the thread */
+  int wake_fd;
+  MetricsRenderFunc render;
+  std::thread thread;
+  /** page of the current request, reused between scrapes */
+  std::string page;
+};
+
+static void
+metrics_send_all (int fd, const char *data, size_t len)
+{
+  while (len) {
+    ssize_t sent = send (fd, data, len, MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR)
+      continue;
+    if (sent <= 0)
+      return;
+    data += sent;
+    len -= sent;
+  }
+}
+
+static void
+metrics_server_handle (MetricsServer *server, int fd)
+{
+  char request[METRICS_MAX_REQUEST];
+  size_t len = 0;
+  char header[256];
+  const char *status;
+
+  /* Read the request line and headers, the body of a GET is ignored. */
+  while (len < sizeof (request) - 1) {
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    if (poll (&pfd, 1, METRICS_REQUEST_TIMEOUT_MS) <= 0)
+      return;
+    ssize_t got = recv (fd, request + len, sizeof (request) - 1 - len, 0);
+    if (got <= 0)
+      return;
+    len += got;
+    request[len] = '\0';
+    if (strstr (request, "\r\n\r\n") || strstr (request, "\n\n"))
+      break;
+  }
+
+  server->page.clear ();
+  if (!strncmp (request, "GET /metrics ", 13) || !strncmp (request, "GET / ", 6)) {
+    server->render (server->page);
+    status = "200 OK";
+  } else if (strncmp (request, "GET ", 4)) {
+    status = "405 Method Not Allowed";
+  } else {
+    status = "404 Not Found";
+  }
+
+  snprintf (header, sizeof (header), "HTTP/1.1 %s\r\n"
+      "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+      "Content-Length: %zu\r\nConnection: close\r\n\r\n",
+      status, server->page.size ());
+  metrics_send_all (fd, header, strlen (header));
+  metrics_send_all (fd, server->page.data (), server->page.size ());
+}
+
+static void
+metrics_server_loop (MetricsServer *server)
+{
+  struct pollfd fds[2] = {
+    { server->listen_fd, POLLIN, 0 },
+    { server->wake_fd, POLLIN, 0 },
+  };
+
+  for (;;) {
+    if (poll (fds, 2, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      return;
+    }
+    if (fds[1].revents)
+      return;
+    if (fds[0].revents & POLLIN) {
+      int fd = accept (server->listen_fd, NULL, NULL);
+      if (fd < 0)
+        continue;
+      metrics_server_handle (server, fd);
+      close (fd);
+    }
+  }
+}
+
+MetricsServer *
+metrics_server_new (const char *bind_address, uint16_t port,
+    MetricsRenderFunc render)
+{
+  struct sockaddr_in addr;
+  int one = 1;
+  int fd, wake_fd, err;
+
+  memset (&addr, 0, sizeof (addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons (port);
+  if (inet_pton (AF_INET, bind_address, &addr.sin_addr) != 1) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  fd = socket (AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return NULL;
+  setsockopt (fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+  if (bind (fd, (struct sockaddr *) &addr, sizeof (addr)) < 0 ||
+      listen (fd, 16) < 0) {
+    err = errno;
+    close (fd);
+    errno = err;
+    return NULL;
+  }
+
+  wake_fd = eventfd (0, EFD_CLOEXEC);
+  if (wake_fd < 0) {
+    err = errno;
+    close (fd);
+    errno = err;
+    return NULL;
+  }
+
+  MetricsServer *server = new MetricsServer ();
+  server->listen_fd = fd;
+  server->wake_fd = wake_fd;
+  server->render = render;
+  server->thread = std::thread (metrics_server_loop, server);
+  return server;
+}
+
+void
+metrics_server_free (MetricsServer *server)
+{
+  uint64_t one = 1;
+
+  if (write (server->wake_fd, &one, sizeof (one)) != sizeof (one))
+    shutdown (server->listen_fd, SHUT_RDWR);
+  server->thread.join ();
+  close (server->wake_fd);
+  close (server->listen_fd);
+  delete server;
+}
+
+void
+metrics_append_header (std::string &out, const char *name, const char *type,
+    const char *help)
+{
+  out += "# HELP ";
+  out += name;
+  out += ' ';
+  out += help;
+  out += "\n# TYPE ";
+  out += name;
+  out += ' ';
+  out += type;
+  out += '\n';
+}
+
+void
+metrics_append_sample (std::string &out, const char *name, const char *labels,
+    double value)
+{
+  char num[32];
+
+  out += name;
+  if (labels) {
+    out += '{';
+    out += labels;
+    out += '}';
+  }
+  snprintf (num, sizeof (num), " %.17g\n", value);
+  out += num;
+}
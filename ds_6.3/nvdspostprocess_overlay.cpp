@@ -0,0 +1,543 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include "nvdspostprocess_overlay.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#define RGBA_BYTES_PER_PIXEL 4
+
+/* (t + 128 + ((t + 128) >> 8)) >> 8 is an exact t / 255 for t <= 255 * 255 */
+static inline uint8_t
+div255 (uint32_t t)
+{
+  t += 128;
+  return (uint8_t) ((t + (t >> 8)) >> 8);
+}
+
+static inline void
+blend_pixel (uint8_t *dst, OverlayColor color)
+{
+  uint32_t inv = 255 - color.a;
+  dst[0] = div255 (dst[0] * inv + color.r * color.a);
+  dst[1] = div255 (dst[1] * inv + color.g * color.a);
+  dst[2] = div255 (dst[2] * inv + color.b * color.a);
+  dst[3] = div255 (dst[3] * inv + 255 * color.a);
+}
+
+void
+overlay_blend_span (uint8_t *dst, uint32_t npix, OverlayColor color)
+{
+  if (color.a == 0 || npix == 0)
+    return;
+
+  /* Opaque colour, plain copy of the pixel pattern. */
+  if (color.a == 255) {
+    uint32_t pattern;
+    memcpy (&pattern, &color, sizeof (pattern));
+    for (uint32_t i = 0; i < npix; i++)
+      memcpy (dst + i * RGBA_BYTES_PER_PIXEL, &pattern, sizeof (pattern));
+    return;
+  }
+
+  uint16_t inv = 255 - color.a;
+  /* Premultiplied colour for two pixels, alpha lane blends towards 255 */
+  uint16_t pre[8] = {
+    (uint16_t) (color.r * color.a), (uint16_t) (color.g * color.a),
+    (uint16_t) (color.b * color.a), (uint16_t) (255 * color.a),
+    (uint16_t) (color.r * color.a), (uint16_t) (color.g * color.a),
+    (uint16_t) (color.b * color.a), (uint16_t) (255 * color.a)
+  };
+  uint32_t i = 0;
+
+#if defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i k128 = _mm_set1_epi16 (128);
+  const __m128i vinv = _mm_set1_epi16 (inv);
+  const __m128i vpre = _mm_loadu_si128 ((const __m128i *) pre);
+  for (; i + 4 <= npix; i += 4) {
+    uint8_t *p = dst + i * RGBA_BYTES_PER_PIXEL;
+    __m128i px = _mm_loadu_si128 ((const __m128i *) p);
+    __m128i lo = _mm_unpacklo_epi8 (px, zero);
+    __m128i hi = _mm_unpackhi_epi8 (px, zero);
+    lo = _mm_add_epi16 (_mm_add_epi16 (_mm_mullo_epi16 (lo, vinv), vpre), k128);
+    hi = _mm_add_epi16 (_mm_add_epi16 (_mm_mullo_epi16 (hi, vinv), vpre), k128);
+    lo = _mm_srli_epi16 (_mm_add_epi16 (lo, _mm_srli_epi16 (lo, 8)), 8);
+    hi = _mm_srli_epi16 (_mm_add_epi16 (hi, _mm_srli_epi16 (hi, 8)), 8);
+    _mm_storeu_si128 ((__m128i *) p, _mm_packus_epi16 (lo, hi));
+  }
+#elif defined(__ARM_NEON)
+  const uint16x8_t vinv = vdupq_n_u16 (inv);
+  const uint16x8_t vpre = vld1q_u16 (pre);
+  for (; i + 4 <= npix; i += 4) {
+    uint8_t *p = dst + i * RGBA_BYTES_PER_PIXEL;
+    uint8x16_t px = vld1q_u8 (p);
+    uint16x8_t lo = vmlaq_u16 (vpre, vmovl_u8 (vget_low_u8 (px)), vinv);
+    uint16x8_t hi = vmlaq_u16 (vpre, vmovl_u8 (vget_high_u8 (px)), vinv);
+    uint8x8_t rlo = vraddhn_u16 (lo, vrshrq_n_u16 (lo, 8));
+    uint8x8_t rhi = vraddhn_u16 (hi, vrshrq_n_u16 (hi, 8));
+    vst1q_u8 (p, vcombine_u8 (rlo, rhi));
+  }
+#endif
+
+  for (; i < npix; i++) {
+    uint8_t *p = dst + i * RGBA_BYTES_PER_PIXEL;
+    for (int c = 0; c < RGBA_BYTES_PER_PIXEL; c++)
+      p[c] = div255 (p[c] * inv + pre[c]);
+  }
+}
+
+void
+overlay_blend_mask_span (uint8_t *dst, const uint8_t *mask, uint32_t npix,
+    OverlayColor color)
+{
+  uint32_t i = 0;
+
+  if (color.a == 0)
+    return;
+
+#if defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i k128 = _mm_set1_epi16 (128);
+  const __m128i k255 = _mm_set1_epi16 (255);
+  const __m128i vca = _mm_set1_epi16 (color.a);
+  const __m128i vcol = _mm_setr_epi16 (color.r, color.g, color.b, 255,
+      color.r, color.g, color.b, 255);
+  for (; i + 4 <= npix; i += 4) {
+    uint32_t m32;
+    memcpy (&m32, mask + i, sizeof (m32));
+    /* Glyph runs are mostly empty, skip the blend for uncovered pixels. */
+    if (m32 == 0)
+      continue;
+    uint8_t *p = dst + i * RGBA_BYTES_PER_PIXEL;
+    /* a_i = m_i * color.a / 255 */
+    __m128i a = _mm_unpacklo_epi8 (_mm_cvtsi32_si128 ((int) m32), zero);
+    a = _mm_add_epi16 (_mm_mullo_epi16 (a, vca), k128);
+    a = _mm_srli_epi16 (_mm_add_epi16 (a, _mm_srli_epi16 (a, 8)), 8);
+    /* Spread each pixel alpha over its four channels. */
+    a = _mm_unpacklo_epi16 (a, a);
+    __m128i alo = _mm_unpacklo_epi32 (a, a);
+    __m128i ahi = _mm_unpackhi_epi32 (a, a);
+    __m128i px = _mm_loadu_si128 ((const __m128i *) p);
+    __m128i lo = _mm_unpacklo_epi8 (px, zero);
+    __m128i hi = _mm_unpackhi_epi8 (px, zero);
+    lo = _mm_add_epi16 (_mm_mullo_epi16 (lo, _mm_sub_epi16 (k255, alo)),
+        _mm_mullo_epi16 (vcol, alo));
+    hi = _mm_add_epi16 (_mm_mullo_epi16 (hi, _mm_sub_epi16 (k255, ahi)),
+        _mm_mullo_epi16 (vcol, ahi));
+    lo = _mm_add_epi16 (lo, k128);
+    hi = _mm_add_epi16 (hi, k128);
+    lo = _mm_srli_epi16 (_mm_add_epi16 (lo, _mm_srli_epi16 (lo, 8)), 8);
+    hi = _mm_srli_epi16 (_mm_add_epi16 (hi, _mm_srli_epi16 (hi, 8)), 8);
+    _mm_storeu_si128 ((__m128i *) p, _mm_packus_epi16 (lo, hi));
+  }
+#elif defined(__ARM_NEON)
+  static const uint8_t spread_lo[8] = { 0, 0, 0, 0, 1, 1, 1, 1 };
+  static const uint8_t spread_hi[8] = { 2, 2, 2, 2, 3, 3, 3, 3 };
+  const uint8x8_t idx_lo = vld1_u8 (spread_lo);
+  const uint8x8_t idx_hi = vld1_u8 (spread_hi);
+  const uint8x8_t vca = vdup_n_u8 (color.a);
+  const uint16x8_t k255 = vdupq_n_u16 (255);
+  const uint16_t col[8] = { color.r, color.g, color.b, 255,
+    color.r, color.g, color.b, 255 };
+  const uint16x8_t vcol = vld1q_u16 (col);
+  for (; i + 4 <= npix; i += 4) {
+    uint32_t m32;
+    memcpy (&m32, mask + i, sizeof (m32));
+    if (m32 == 0)
+      continue;
+    uint8_t *p = dst + i * RGBA_BYTES_PER_PIXEL;
+    uint8x8_t m = vreinterpret_u8_u32 (vdup_n_u32 (m32));
+    uint16x8_t tlo = vmull_u8 (vtbl1_u8 (m, idx_lo), vca);
+    uint16x8_t thi = vmull_u8 (vtbl1_u8 (m, idx_hi), vca);
+    uint16x8_t alo = vmovl_u8 (vraddhn_u16 (tlo, vrshrq_n_u16 (tlo, 8)));
+    uint16x8_t ahi = vmovl_u8 (vraddhn_u16 (thi, vrshrq_n_u16 (thi, 8)));
+    uint8x16_t px = vld1q_u8 (p);
+    uint16x8_t lo = vmlaq_u16 (vmulq_u16 (vcol, alo),
+        vmovl_u8 (vget_low_u8 (px)), vsubq_u16 (k255, alo));
+    uint16x8_t hi = vmlaq_u16 (vmulq_u16 (vcol, ahi),
+        vmovl_u8 (vget_high_u8 (px)), vsubq_u16 (k255, ahi));
+    vst1q_u8 (p, vcombine_u8 (vraddhn_u16 (lo, vrshrq_n_u16 (lo, 8)),
+            vraddhn_u16 (hi, vrshrq_n_u16 (hi, 8))));
+  }
+#endif
+
+  for (; i < npix; i++) {
+    if (mask[i] == 0)
+      continue;
+    OverlayColor c = color;
+    c.a = div255 (mask[i] * color.a);
+    blend_pixel (dst + i * RGBA_BYTES_PER_PIXEL, c);
+  }
+}
+
+static inline bool
+rect_empty (const OverlayRect &r)
+{
+  return r.left >= r.right || r.top >= r.bottom;
+}
+
+static inline OverlayRect
+rect_union (const OverlayRect &a, const OverlayRect &b)
+{
+  return { std::min (a.left, b.left), std::min (a.top, b.top),
+      std::max (a.right, b.right), std::max (a.bottom, b.bottom) };
+}
+
+static inline int64_t
+rect_area (const OverlayRect &r)
+{
+  return (int64_t) (r.right - r.left) * (r.bottom - r.top);
+}
+
+static inline OverlayRect
+clip_rect (const OverlaySurface *surf, OverlayRect r)
+{
+  r.left = std::max (r.left, 0);
+  r.top = std::max (r.top, 0);
+  r.right = std::min (r.right, (int32_t) surf->width);
+  r.bottom = std::min (r.bottom, (int32_t) surf->height);
+  return r;
+}
+
+/* Record a drawn region. Touching or overlapping regions are merged, and once
+ * the list is full the region is merged into the entry growing the least. */
+static void
+mark_dirty (OverlaySurface *surf, OverlayRect r)
+{
+  r = clip_rect (surf, r);
+  if (rect_empty (r))
+    return;
+
+  bool merged = true;
+  while (merged) {
+    merged = false;
+    for (size_t i = 0; i < surf->dirty.size (); i++) {
+      const OverlayRect &d = surf->dirty[i];
+      if (r.left <= d.right && d.left <= r.right &&
+          r.top <= d.bottom && d.top <= r.bottom) {
+        r = rect_union (r, d);
+        surf->dirty[i] = surf->dirty.back ();
+        surf->dirty.pop_back ();
+        merged = true;
+        break;
+      }
+    }
+  }
+
+  if (surf->dirty.size () < OVERLAY_MAX_DIRTY_RECTS) {
+    surf->dirty.push_back (r);
+    return;
+  }
+
+  size_t best = 0;
+  int64_t best_growth = INT64_MAX;
+  for (size_t i = 0; i < surf->dirty.size (); i++) {
+    int64_t growth = rect_area (rect_union (r, surf->dirty[i])) -
+        rect_area (surf->dirty[i]);
+    if (growth < best_growth) {
+      best_growth = growth;
+      best = i;
+    }
+  }
+  surf->dirty[best] = rect_union (r, surf->dirty[best]);
+}
+
+/* Blend [x0, x1) on row y, clipped to the surface. */
+static inline void
+blend_hspan (OverlaySurface *surf, int32_t x0, int32_t x1, int32_t y,
+    OverlayColor color)
+{
+  if (y < 0 || y >= (int32_t) surf->height)
+    return;
+  x0 = std::max (x0, 0);
+  x1 = std::min (x1, (int32_t) surf->width);
+  if (x0 >= x1)
+    return;
+  overlay_blend_span (surf->data + (size_t) y * surf->pitch +
+      (size_t) x0 * RGBA_BYTES_PER_PIXEL, x1 - x0, color);
+}
+
+/* Blend [y0, y1) on column x, clipped to the surface. */
+static inline void
+blend_vspan (OverlaySurface *surf, int32_t x, int32_t y0, int32_t y1,
+    OverlayColor color)
+{
+  if (x < 0 || x >= (int32_t) surf->width)
+    return;
+  y0 = std::max (y0, 0);
+  y1 = std::min (y1, (int32_t) surf->height);
+  uint8_t *p = surf->data + (size_t) x * RGBA_BYTES_PER_PIXEL;
+  for (int32_t y = y0; y < y1; y++)
+    blend_pixel (p + (size_t) y * surf->pitch, color);
+}
+
+void
+overlay_blend_mask (OverlaySurface *surf, const uint8_t *mask,
+    uint32_t mask_width, uint32_t mask_height, int32_t x, int32_t y,
+    OverlayColor color)
+{
+  OverlayRect rect = clip_rect (surf, { x, y, x + (int32_t) mask_width,
+      y + (int32_t) mask_height });
+
+  if (rect_empty (rect) || color.a == 0)
+    return;
+
+  for (int32_t row = rect.top; row < rect.bottom; row++)
+    overlay_blend_mask_span (surf->data + (size_t) row * surf->pitch +
+        (size_t) rect.left * RGBA_BYTES_PER_PIXEL,
+        mask + (size_t) (row - y) * mask_width + (rect.left - x),
+        rect.right - rect.left, color);
+  mark_dirty (surf, rect);
+}
+
+void
+overlay_compile_polygon (OverlayPolygon *poly)
+{
+  size_t n = poly->pts.size ();
+
+  poly->edges.clear ();
+  poly->bounds = { 0, 0, 0, 0 };
+  if (n == 0)
+    return;
+
+  poly->bounds = { poly->pts[0].x, poly->pts[0].y,
+      poly->pts[0].x + 1, poly->pts[0].y + 1 };
+  for (size_t i = 0; i < n; i++) {
+    OverlayPoint a = poly->pts[i];
+    OverlayPoint b = poly->pts[(i + 1) % n];
+
+    poly->bounds = rect_union (poly->bounds, { a.x, a.y, a.x + 1, a.y + 1 });
+
+    /* Horizontal edges never cross a scanline centre. */
+    if (a.y == b.y)
+      continue;
+    if (a.y > b.y)
+      std::swap (a, b);
+
+    OverlayEdge edge;
+    edge.y_start = a.y;
+    edge.y_end = b.y;
+    edge.dxdy = (float) (b.x - a.x) / (float) (b.y - a.y);
+    edge.x = a.x + 0.5f * edge.dxdy;
+    poly->edges.push_back (edge);
+  }
+
+  std::sort (poly->edges.begin (), poly->edges.end (),
+      [](const OverlayEdge &l, const OverlayEdge &r) {
+        return l.y_start < r.y_start;
+      });
+}
+
+void
+overlay_begin_frame (OverlaySurface *surf, uint8_t *data, uint32_t width,
+    uint32_t height, uint32_t pitch)
+{
+  surf->data = data;
+  surf->width = width;
+  surf->height = height;
+  surf->pitch = pitch;
+  surf->dirty.clear ();
+}
+
+void
+overlay_fill_rect (OverlaySurface *surf, OverlayRect rect, OverlayColor color)
+{
+  rect = clip_rect (surf, rect);
+  if (rect_empty (rect) || color.a == 0)
+    return;
+
+  for (int32_t y = rect.top; y < rect.bottom; y++)
+    overlay_blend_span (surf->data + (size_t) y * surf->pitch +
+        (size_t) rect.left * RGBA_BYTES_PER_PIXEL, rect.right - rect.left,
+        color);
+  mark_dirty (surf, rect);
+}
+
+void
+overlay_draw_rect (OverlaySurface *surf, OverlayRect rect, uint32_t thickness,
+    OverlayColor color)
+{
+  int32_t t = (int32_t) thickness;
+
+  if (rect_empty (rect) || t == 0)
+    return;
+
+  /* Thick enough to cover the whole box. */
+  if (2 * t >= rect.right - rect.left || 2 * t >= rect.bottom - rect.top) {
+    overlay_fill_rect (surf, rect, color);
+    return;
+  }
+
+  /* Four non overlapping bands so translucent borders blend once. */
+  overlay_fill_rect (surf, { rect.left, rect.top, rect.right, rect.top + t },
+      color);
+  overlay_fill_rect (surf,
+      { rect.left, rect.bottom - t, rect.right, rect.bottom }, color);
+  overlay_fill_rect (surf,
+      { rect.left, rect.top + t, rect.left + t, rect.bottom - t }, color);
+  overlay_fill_rect (surf,
+      { rect.right - t, rect.top + t, rect.right, rect.bottom - t }, color);
+}
+
+/* Bresenham walk along the major axis, laying a span of @thickness pixels
+ * across the minor axis at every step. */
+static void
+draw_line_spans (OverlaySurface *surf, OverlayPoint p0, OverlayPoint p1,
+    int32_t thickness, OverlayColor color)
+{
+  int32_t dx = std::abs (p1.x - p0.x);
+  int32_t dy = std::abs (p1.y - p0.y);
+  int32_t sx = p0.x < p1.x ? 1 : -1;
+  int32_t sy = p0.y < p1.y ? 1 : -1;
+  int32_t half = thickness / 2;
+  int32_t x = p0.x, y = p0.y;
+
+  if (dx >= dy) {
+    int32_t err = dx / 2;
+    for (int32_t i = 0; i <= dx; i++) {
+      blend_vspan (surf, x, y - half, y - half + thickness, color);
+      x += sx;
+      err -= dy;
+      if (err < 0) {
+        y += sy;
+        err += dx;
+      }
+    }
+  } else {
+    int32_t err = dy / 2;
+    for (int32_t i = 0; i <= dy; i++) {
+      blend_hspan (surf, x - half, x - half + thickness, y, color);
+      y += sy;
+      err -= dx;
+      if (err < 0) {
+        x += sx;
+        err += dy;
+      }
+    }
+  }
+}
+
+void
+overlay_draw_line (OverlaySurface *surf, OverlayPoint p0, OverlayPoint p1,
+    uint32_t thickness, OverlayColor color)
+{
+  int32_t t = (int32_t) thickness;
+  int32_t half = t / 2;
+
+  if (t == 0 || color.a == 0)
+    return;
+
+  draw_line_spans (surf, p0, p1, t, color);
+  mark_dirty (surf, { std::min (p0.x, p1.x) - half, std::min (p0.y, p1.y) - half,
+      std::max (p0.x, p1.x) - half + t, std::max (p0.y, p1.y) - half + t });
+}
+
+void
+overlay_fill_polygon (OverlaySurface *surf, const OverlayPolygon *poly,
+    OverlayColor color, OverlayScratch *scratch)
+{
+  const std::vector<OverlayEdge> &edges = poly->edges;
+  std::vector<OverlayEdge> &active = scratch->active;
+  std::vector<float> &xs = scratch->xs;
+  size_t next = 0;
+
+  if (edges.empty () || color.a == 0)
+    return;
+
+  OverlayRect area = clip_rect (surf, poly->bounds);
+  if (rect_empty (area))
+    return;
+
+  active.clear ();
+  for (int32_t y = area.top; y < area.bottom; y++) {
+    /* Activate the edges starting on or above this scanline. */
+    while (next < edges.size () && edges[next].y_start <= y) {
+      OverlayEdge e = edges[next++];
+      if (e.y_end <= y)
+        continue;
+      e.x += (y - e.y_start) * e.dxdy;
+      active.push_back (e);
+    }
+
+    /* Retire the edges that ended. */
+    for (size_t i = 0; i < active.size ();) {
+      if (active[i].y_end <= y) {
+        active[i] = active.back ();
+        active.pop_back ();
+      } else {
+        i++;
+      }
+    }
+
+    xs.clear ();
+    for (const OverlayEdge &e : active)
+      xs.push_back (e.x);
+    /* A handful of crossings per row, insertion sort beats std::sort. */
+    for (size_t i = 1; i < xs.size (); i++) {
+      float v = xs[i];
+      size_t j = i;
+      for (; j > 0 && xs[j - 1] > v; j--)
+        xs[j] = xs[j - 1];
+      xs[j] = v;
+    }
+
+    /* Even-odd rule, pixel centres inside [xa, xb) are covered. */
+    for (size_t i = 0; i + 1 < xs.size (); i += 2) {
+      int32_t xa = (int32_t) std::ceil (xs[i] - 0.5f);
+      int32_t xb = (int32_t) std::ceil (xs[i + 1] - 0.5f);
+      blend_hspan (surf, xa, xb, y, color);
+    }
+
+    for (OverlayEdge &e : active)
+      e.x += e.dxdy;
+  }
+
+  mark_dirty (surf, area);
+}
+
+void
+overlay_draw_polygon (OverlaySurface *surf, const OverlayPolygon *poly,
+    uint32_t thickness)
+{
+  size_t n = poly->pts.size ();
+  int32_t t = (int32_t) thickness;
+  int32_t half = t / 2;
+
+  if (n < 2 || t == 0 || poly->border.a == 0)
+    return;
+
+  for (size_t i = 0; i < n; i++)
+    draw_line_spans (surf, poly->pts[i], poly->pts[(i + 1) % n], t,
+        poly->border);
+
+  mark_dirty (surf, { poly->bounds.left - half, poly->bounds.top - half,
+      poly->bounds.right - half + t, poly->bounds.bottom - half + t });
+}
@@ -0,0 +1,411 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "nvdspostprocess_record.h"
+
+/** period after which a partly filled buffer is written anyway */
+#define RECORD_FLUSH_INTERVAL_MS 1000
+
+/** bound of the front buffer, in buffer_size units, while a write is slow */
+#define RECORD_MAX_PENDING_BUFFERS 8
+
+/* Offsets of the columns from the start of a block. */
+typedef struct
+{
+  size_t frame_pts;
+  size_t source_id;
+  size_t frame_num;
+  size_t num_objects;
+  size_t object_id;
+  size_t left;
+  size_t top;
+  size_t width;
+  size_t height;
+  size_t confidence;
+  size_t class_id;
+  /** whole block */
+  size_t size;
+} RecordLayout;
+
+struct _RecordWriter
+{
+  int fd;
+  size_t buffer_size;
+  /** protects everything below but the thread */
+  std::mutex lock;
+  std::condition_variable cond;
+  /** filled by record_writer_append */
+  std::vector<uint8_t> front;
+  uint64_t front_batches;
+  /** being written by the writer thread, empty when it is idle */
+  std::vector<uint8_t> back;
+  uint64_t back_batches;
+  bool stop;
+  /** a write failed, nothing is recorded anymore */
+  bool failed;
+  std::thread thread;
+  std::atomic<uint64_t> dropped;
+};
+
+struct _RecordReader
+{
+  const uint8_t *data;
+  size_t size;
+  /** start of the next block */
+  size_t offset;
+};
+
+static inline size_t
+record_pad (size_t size)
+{
+  return (size + 7) & ~(size_t) 7;
+}
+
+static void
+record_layout (uint64_t num_frames, uint64_t num_objects, RecordLayout *l)
+{
+  size_t offset = sizeof (RecordBlockHeader);
+
+  /* 8 byte columns first, every column starts 8 byte aligned. */
+  l->frame_pts = offset;
+  offset += record_pad (num_frames * sizeof (uint64_t));
+  l->source_id = offset;
+  offset += record_pad (num_frames * sizeof (uint32_t));
+  l->frame_num = offset;
+  offset += record_pad (num_frames * sizeof (int32_t));
+  l->num_objects = offset;
+  offset += record_pad (num_frames * sizeof (uint32_t));
+  l->object_id = offset;
+  offset += record_pad (num_objects * sizeof (uint64_t));
+  l->left = offset;
+  offset += record_pad (num_objects * sizeof (float));
+  l->top = offset;
+  offset += record_pad (num_objects * sizeof (float));
+  l->width = offset;
+  offset += record_pad (num_objects * sizeof (float));
+  l->height = offset;
+  offset += record_pad (num_objects * sizeof (float));
+  l->confidence = offset;
+  offset += record_pad (num_objects * sizeof (float));
+  l->class_id = offset;
+  offset += record_pad (num_objects * sizeof (int32_t));
+  l->size = offset;
+}
+
+template <typename T> static inline void
+record_put_column (uint8_t *block, size_t offset, const std::vector<T> &column)
+{
+  if (!column.empty ())
+    memcpy (block + offset, column.data (), column.size () * sizeof (T));
+}
+
+static bool
+record_write_all (int fd, const uint8_t *data, size_t size)
+{
+  while (size) {
+    ssize_t written = write (fd, data, size);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    data += written;
+    size -= written;
+  }
+  return true;
+}
+
+static void
+record_writer_loop (RecordWriter *writer)
+{
+  std::unique_lock<std::mutex> guard (writer->lock);
+
+  for (;;) {
+    if (writer->back.empty () && !writer->stop) {
+      writer->cond.wait_for (guard,
+          std::chrono::milliseconds (RECORD_FLUSH_INTERVAL_MS));
+      /* Slow stream, don't keep a partial buffer in memory forever. */
+      if (writer->back.empty () && !writer->front.empty ()) {
+        writer->front.swap (writer->back);
+        writer->back_batches = writer->front_batches;
+        writer->front_batches = 0;
+      }
+    }
+
+    if (!writer->back.empty ()) {
+      bool ok;
+
+      guard.unlock ();
+      ok = record_write_all (writer->fd, writer->back.data (),
+          writer->back.size ());
+      guard.lock ();
+      if (!ok) {
+        writer->failed = true;
+        writer->dropped.fetch_add (writer->back_batches,
+            std::memory_order_relaxed);
+      }
+      writer->back.clear ();
+      writer->back_batches = 0;
+      continue;
+    }
+
+    if (writer->stop)
+      break;
+  }
+}
+
+void
+record_batch_clear (RecordBatch *batch)
+{
+  batch->frame_pts.clear ();
+  batch->source_id.clear ();
+  batch->frame_num.clear ();
+  batch->num_objects.clear ();
+  batch->object_id.clear ();
+  batch->left.clear ();
+  batch->top.clear ();
+  batch->width.clear ();
+  batch->height.clear ();
+  batch->confidence.clear ();
+  batch->class_id.clear ();
+}
+
+RecordWriter *
+record_writer_new (const char *path, size_t buffer_size)
+{
+  RecordFileHeader header = {};
+  RecordWriter *writer;
+  int fd = open (path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+  if (fd < 0)
+    return NULL;
+
+  memcpy (header.magic, RECORD_FILE_MAGIC, sizeof (header.magic));
+  header.version = RECORD_FILE_VERSION;
+  if (!record_write_all (fd, (const uint8_t *) &header, sizeof (header))) {
+    int err = errno;
+    close (fd);
+    errno = err;
+    return NULL;
+  }
+
+  writer = new RecordWriter ();
+  writer->fd = fd;
+  writer->buffer_size = buffer_size;
+  writer->front.reserve (buffer_size);
+  writer->back.reserve (buffer_size);
+  writer->thread = std::thread (record_writer_loop, writer);
+  return writer;
+}
+
+void
+record_writer_append (RecordWriter *writer, const RecordBatch *batch)
+{
+  uint32_t num_frames = batch->source_id.size ();
+  uint32_t num_objects = batch->object_id.size ();
+  RecordBlockHeader header = {};
+  RecordLayout l;
+  uint8_t *block;
+  size_t offset;
+
+  record_layout (num_frames, num_objects, &l);
+
+  std::lock_guard<std::mutex> guard (writer->lock);
+
+  if (writer->failed || writer->front.size () + l.size >
+      RECORD_MAX_PENDING_BUFFERS * writer->buffer_size) {
+    writer->dropped.fetch_add (1, std::memory_order_relaxed);
+    return;
+  }
+
+  /* resize zero fills, the column padding is written as zeroes. */
+  offset = writer->front.size ();
+  writer->front.resize (offset + l.size);
+  block = writer->front.data () + offset;
+
+  header.magic = RECORD_BLOCK_MAGIC;
+  header.num_frames = num_frames;
+  header.num_objects = num_objects;
+  header.block_size = l.size;
+  header.batch_num = batch->batch_num;
+  header.pts = batch->pts;
+  memcpy (block, &header, sizeof (header));
+  record_put_column (block, l.frame_pts, batch->frame_pts);
+  record_put_column (block, l.source_id, batch->source_id);
+  record_put_column (block, l.frame_num, batch->frame_num);
+  record_put_column (block, l.num_objects, batch->num_objects);
+  record_put_column (block, l.object_id, batch->object_id);
+  record_put_column (block, l.left, batch->left);
+  record_put_column (block, l.top, batch->top);
+  record_put_column (block, l.width, batch->width);
+  record_put_column (block, l.height, batch->height);
+  record_put_column (block, l.confidence, batch->confidence);
+  record_put_column (block, l.class_id, batch->class_id);
+  writer->front_batches++;
+
+  /* Hand the buffer over if the writer thread is idle, otherwise keep
+   * filling this one. */
+  if (writer->front.size () >= writer->buffer_size && writer->back.empty ()) {
+    writer->front.swap (writer->back);
+    writer->back_batches = writer->front_batches;
+    writer->front_batches = 0;
+    writer->cond.notify_one ();
+  }
+}
+
+uint64_t
+record_writer_dropped (RecordWriter *writer)
+{
+  return writer->dropped.load (std::memory_order_relaxed);
+}
+
+uint64_t
+record_writer_free (RecordWriter *writer)
+{
+  uint64_t dropped;
+
+  {
+    std::lock_guard<std::mutex> guard (writer->lock);
+    writer->stop = true;
+    writer->cond.notify_one ();
+  }
+  writer->thread.join ();
+
+  if (!writer->front.empty () && !writer->failed &&
+      !record_write_all (writer->fd, writer->front.data (),
+          writer->front.size ()))
+    writer->dropped.fetch_add (writer->front_batches,
+        std::memory_order_relaxed);
+
+  close (writer->fd);
+  dropped = writer->dropped.load (std::memory_order_relaxed);
+  delete writer;
+  return dropped;
+}
+
+RecordReader *
+record_reader_open (const char *path)
+{
+  RecordFileHeader header;
+  RecordReader *reader;
+  struct stat st;
+  void *data;
+  int fd = open (path, O_RDONLY | O_CLOEXEC);
+
+  if (fd < 0)
+    return NULL;
+
+  if (fstat (fd, &st) < 0) {
+    int err = errno;
+    close (fd);
+    errno = err;
+    return NULL;
+  }
+  if ((size_t) st.st_size < sizeof (header)) {
+    close (fd);
+    errno = EINVAL;
+    return NULL;
+  }
+
+  data = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (data == MAP_FAILED)
+    return NULL;
+
+  memcpy (&header, data, sizeof (header));
+  if (memcmp (header.magic, RECORD_FILE_MAGIC, sizeof (header.magic)) ||
+      header.version != RECORD_FILE_VERSION) {
+    munmap (data, st.st_size);
+    errno = EINVAL;
+    return NULL;
+  }
+  madvise (data, st.st_size, MADV_SEQUENTIAL);
+
+  reader = new RecordReader ();
+  reader->data = (const uint8_t *) data;
+  reader->size = st.st_size;
+  reader->offset = sizeof (header);
+  return reader;
+}
+
+bool
+record_reader_next (RecordReader *reader, RecordBatchView *view)
+{
+  const uint8_t *block = reader->data + reader->offset;
+  size_t remaining = reader->size - reader->offset;
+  RecordBlockHeader header;
+  RecordLayout l;
+
+  if (remaining < sizeof (header))
+    return false;
+  memcpy (&header, block, sizeof (header));
+  if (header.magic != RECORD_BLOCK_MAGIC)
+    return false;
+  record_layout (header.num_frames, header.num_objects, &l);
+  if (header.block_size < l.size || header.block_size % 8 ||
+      header.block_size > remaining)
+    return false;
+
+  view->batch_num = header.batch_num;
+  view->pts = header.pts;
+  view->num_frames = header.num_frames;
+  view->num_objects = header.num_objects;
+  view->frame_pts = (const uint64_t *) (block + l.frame_pts);
+  view->source_id = (const uint32_t *) (block + l.source_id);
+  view->frame_num = (const int32_t *) (block + l.frame_num);
+  view->frame_num_objects = (const uint32_t *) (block + l.num_objects);
+  view->object_id = (const uint64_t *) (block + l.object_id);
+  view->left = (const float *) (block + l.left);
+  view->top = (const float *) (block + l.top);
+  view->width = (const float *) (block + l.width);
+  view->height = (const float *) (block + l.height);
+  view->confidence = (const float *) (block + l.confidence);
+  view->class_id = (const int32_t *) (block + l.class_id);
+
+  reader->offset += header.block_size;
+  return true;
+}
+
+void
+record_reader_rewind (RecordReader *reader)
+{
+  reader->offset = sizeof (RecordFileHeader);
+}
+
+void
+record_reader_close (RecordReader *reader)
+{
+  munmap ((void *) reader->data, reader->size);
+  delete reader;
+}
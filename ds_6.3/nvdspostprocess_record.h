@@ -0,0 +1,164 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef __NVDSPOSTPROCESS_RECORD_H__
+#define __NVDSPOSTPROCESS_RECORD_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Columnar recording of the object metadata of every batch, to replay
+ * production load offline.
+ *
+ * The file is a RecordFileHeader followed by one block per batch. A block is
+ * a RecordBlockHeader and the columns of its frames then of its objects,
+ * each column padded to 8 bytes, so that a mapped file is read in place.
+ * Values are in host byte order. A block cut short by a crash ends the
+ * replay.
+ *
+ * Recording is asynchronous: batches are serialized into a front buffer
+ * which a writer thread swaps with its own and writes while the next
+ * batches fill the other one.
+ */
+
+#define RECORD_FILE_MAGIC "NVDSPPRC"
+#define RECORD_FILE_VERSION 1
+#define RECORD_BLOCK_MAGIC 0x48435442 /* "BTCH" */
+
+typedef struct
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+} RecordFileHeader;
+
+typedef struct
+{
+  uint32_t magic;
+  uint32_t num_frames;
+  uint32_t num_objects;
+  uint32_t reserved;
+  /** header and columns, multiple of 8 */
+  uint64_t block_size;
+  uint64_t batch_num;
+  /** pts of the batch buffer */
+  uint64_t pts;
+} RecordBlockHeader;
+
+/** columns of a batch being recorded, reused between batches */
+typedef struct
+{
+  uint64_t batch_num;
+  uint64_t pts;
+  /** one entry per frame */
+  std::vector<uint64_t> frame_pts;
+  std::vector<uint32_t> source_id;
+  std::vector<int32_t> frame_num;
+  /** objects of the frame, which follow the ones of the previous frames */
+  std::vector<uint32_t> num_objects;
+  /** one entry per object */
+  std::vector<uint64_t> object_id;
+  std::vector<float> left;
+  std::vector<float> top;
+  std::vector<float> width;
+  std::vector<float> height;
+  std::vector<float> confidence;
+  std::vector<int32_t> class_id;
+} RecordBatch;
+
+/** batch read in place from a mapped recording */
+typedef struct
+{
+  uint64_t batch_num;
+  uint64_t pts;
+  uint32_t num_frames;
+  uint32_t num_objects;
+  const uint64_t *frame_pts;
+  const uint32_t *source_id;
+  const int32_t *frame_num;
+  const uint32_t *frame_num_objects;
+  const uint64_t *object_id;
+  const float *left;
+  const float *top;
+  const float *width;
+  const float *height;
+  const float *confidence;
+  const int32_t *class_id;
+} RecordBatchView;
+
+typedef struct _RecordWriter RecordWriter;
+typedef struct _RecordReader RecordReader;
+
+/** Empty the columns, keeping their capacity. */
+void record_batch_clear (RecordBatch *batch);
+
+/**
+ * Create the recording and start the writer thread.
+ *
+ * @param path output file, truncated
+ * @param buffer_size bytes serialized before the buffer is handed to the
+ *   writer thread
+ * @return NULL with errno set if the file can't be created
+ */
+RecordWriter *record_writer_new (const char *path, size_t buffer_size);
+
+/**
+ * Serialize a batch. Never waits for the disk: while the writer thread is
+ * busy the front buffer keeps growing, up to a bound beyond which batches
+ * are dropped and counted.
+ */
+void record_writer_append (RecordWriter *writer, const RecordBatch *batch);
+
+/** Batches dropped because the disk could not keep up or a write failed. */
+uint64_t record_writer_dropped (RecordWriter *writer);
+
+/**
+ * Write the buffered batches and close the file.
+ *
+ * @return batches dropped over the whole recording, the last writes included
+ */
+uint64_t record_writer_free (RecordWriter *writer);
+
+/**
+ * Map a recording.
+ *
+ * @return NULL with errno set, EINVAL if the file is not a recording
+ */
+RecordReader *record_reader_open (const char *path);
+
+/**
+ * Next batch of the recording.
+ *
+ * @return false at the end of the file or on a truncated block
+ */
+bool record_reader_next (RecordReader *reader, RecordBatchView *view);
+
+/** Go back to the first batch. */
+void record_reader_rewind (RecordReader *reader);
+
+/** Unmap the recording. */
+void record_reader_close (RecordReader *reader);
+
+#endif /* __NVDSPOSTPROCESS_RECORD_H__ */
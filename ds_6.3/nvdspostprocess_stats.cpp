@@ -0,0 +1,133 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include "nvdspostprocess_stats.h"
+
+/* Lowest value falling into a bucket. */
+static uint64_t
+latency_histogram_bucket_low (uint32_t bucket)
+{
+  if (bucket < LATENCY_HISTOGRAM_SUB_BUCKETS)
+    return bucket;
+
+  uint32_t exp = (bucket >> LATENCY_HISTOGRAM_SUB_BITS) +
+      LATENCY_HISTOGRAM_SUB_BITS - 1;
+  uint64_t mantissa = LATENCY_HISTOGRAM_SUB_BUCKETS +
+      (bucket & (LATENCY_HISTOGRAM_SUB_BUCKETS - 1));
+  return mantissa << (exp - LATENCY_HISTOGRAM_SUB_BITS);
+}
+
+static uint64_t
+latency_histogram_bucket_mid (uint32_t bucket)
+{
+  uint64_t low = latency_histogram_bucket_low (bucket);
+
+  if (bucket < LATENCY_HISTOGRAM_SUB_BUCKETS)
+    return low;
+  return low + (latency_histogram_bucket_low (bucket + 1) - low) / 2;
+}
+
+void
+latency_histogram_reset (LatencyHistogram *hist)
+{
+  hist->sum_ns.store (0, std::memory_order_relaxed);
+  hist->max_ns.store (0, std::memory_order_relaxed);
+  for (uint32_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++)
+    hist->buckets[i].store (0, std::memory_order_relaxed);
+}
+
+void
+latency_histogram_summarize (const LatencyHistogram *hist,
+    LatencyHistogramSummary *summary)
+{
+  uint64_t snapshot[LATENCY_HISTOGRAM_BUCKETS];
+  const double quantiles[] = { 0.50, 0.90, 0.99 };
+  uint64_t *results[] = { &summary->p50_ns, &summary->p90_ns,
+    &summary->p99_ns };
+  uint64_t total = 0, seen = 0;
+  uint32_t q = 0;
+
+  memset (summary, 0, sizeof (*summary));
+
+  /* Copy first so that the percentiles agree with the count. */
+  for (uint32_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+    snapshot[i] = hist->buckets[i].load (std::memory_order_relaxed);
+    total += snapshot[i];
+  }
+  if (!total)
+    return;
+
+  for (uint32_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS && q < 3; i++) {
+    seen += snapshot[i];
+    while (q < 3 && seen >= (uint64_t) (quantiles[q] * total + 0.5)) {
+      *results[q] = latency_histogram_bucket_mid (i);
+      q++;
+    }
+  }
+
+  summary->count = total;
+  summary->sum_ns = hist->sum_ns.load (std::memory_order_relaxed);
+  summary->mean_ns = summary->sum_ns / total;
+  summary->max_ns = hist->max_ns.load (std::memory_order_relaxed);
+}
+
+void
+source_counters_reset (SourceCounters *counters)
+{
+  counters->frames.store (0, std::memory_order_relaxed);
+  counters->frames_interpolated.store (0, std::memory_order_relaxed);
+  counters->objects_examined.store (0, std::memory_order_relaxed);
+  counters->objects_counted.store (0, std::memory_order_relaxed);
+  counters->events.store (0, std::memory_order_relaxed);
+  counters->last_frame_ns.store (0, std::memory_order_relaxed);
+  counters->fps.store (0, std::memory_order_relaxed);
+  counters->ewma_fps.store (0, std::memory_order_relaxed);
+}
+
+void
+source_counters_summarize (const SourceCounters *counters, uint64_t now_ns,
+    SourceCountersSummary *summary)
+{
+  uint64_t last = counters->last_frame_ns.load (std::memory_order_relaxed);
+
+  summary->frames = counters->frames.load (std::memory_order_relaxed);
+  summary->frames_interpolated =
+      counters->frames_interpolated.load (std::memory_order_relaxed);
+  summary->objects_examined =
+      counters->objects_examined.load (std::memory_order_relaxed);
+  summary->objects_counted =
+      counters->objects_counted.load (std::memory_order_relaxed);
+  summary->events = counters->events.load (std::memory_order_relaxed);
+  summary->fps = counters->fps.load (std::memory_order_relaxed);
+  summary->ewma_fps = counters->ewma_fps.load (std::memory_order_relaxed);
+
+  /* No frame for longer than the last interval, the rate is at most what
+   * the silence allows. */
+  if (last && now_ns > last) {
+    double dt = (now_ns - last) * 1e-9;
+    if (1.0 / dt < summary->fps) {
+      summary->fps = 1.0 / dt;
+      summary->ewma_fps *= std::exp (-dt / SOURCE_FPS_EWMA_TAU);
+    }
+  }
+}
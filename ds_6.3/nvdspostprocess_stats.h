@@ -0,0 +1,183 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __NVDSPOSTPROCESS_STATS_H__
+#define __NVDSPOSTPROCESS_STATS_H__
+
+#include <stdint.h>
+#include <time.h>
+#include <cmath>
+#include <atomic>
+
+/**
+ * Log-linear latency histograms cheap enough to stay enabled in production.
+ * Values below 8 ns get their own bucket, above that every power of two is
+ * split in 8 sub-buckets, so percentiles are within 12.5% of the real value
+ * over the whole 64 bit range. Recording is two relaxed atomic adds and a
+ * bucket index computed from the leading zero count.
+ */
+
+/** sub-buckets per power of two, as a power of two */
+#define LATENCY_HISTOGRAM_SUB_BITS 3
+#define LATENCY_HISTOGRAM_SUB_BUCKETS (1 << LATENCY_HISTOGRAM_SUB_BITS)
+#define LATENCY_HISTOGRAM_BUCKETS (64 * LATENCY_HISTOGRAM_SUB_BUCKETS)
+
+/** histogram of durations in nanoseconds, zero filled memory is empty */
+typedef struct
+{
+  std::atomic<uint64_t> sum_ns;
+  std::atomic<uint64_t> max_ns;
+  std::atomic<uint64_t> buckets[LATENCY_HISTOGRAM_BUCKETS];
+} LatencyHistogram;
+
+/** point in time view of a histogram */
+typedef struct
+{
+  uint64_t count;
+  uint64_t sum_ns;
+  uint64_t mean_ns;
+  uint64_t p50_ns;
+  uint64_t p90_ns;
+  uint64_t p99_ns;
+  uint64_t max_ns;
+} LatencyHistogramSummary;
+
+/** Monotonic clock in nanoseconds, served by the vDSO without a syscall. */
+static inline uint64_t
+latency_now_ns (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static inline uint32_t
+latency_histogram_bucket (uint64_t ns)
+{
+  if (ns < LATENCY_HISTOGRAM_SUB_BUCKETS)
+    return (uint32_t) ns;
+
+  uint32_t exp = 63 - __builtin_clzll (ns);
+  uint32_t mantissa = (uint32_t) (ns >> (exp - LATENCY_HISTOGRAM_SUB_BITS)) &
+      (LATENCY_HISTOGRAM_SUB_BUCKETS - 1);
+  return ((exp - LATENCY_HISTOGRAM_SUB_BITS + 1) << LATENCY_HISTOGRAM_SUB_BITS)
+      + mantissa;
+}
+
+/**
+ * Add a sample, safe to call from any number of threads.
+ */
+static inline void
+latency_histogram_record (LatencyHistogram *hist, uint64_t ns)
+{
+  hist->buckets[latency_histogram_bucket (ns)].fetch_add (1,
+      std::memory_order_relaxed);
+  hist->sum_ns.fetch_add (ns, std::memory_order_relaxed);
+
+  /* The max only moves on new highs, almost never past warm up. */
+  uint64_t max = hist->max_ns.load (std::memory_order_relaxed);
+  while (ns > max && !hist->max_ns.compare_exchange_weak (max, ns,
+          std::memory_order_relaxed));
+}
+
+/** time constant of the smoothed source frame rate, in seconds */
+#define SOURCE_FPS_EWMA_TAU 1.0
+
+/**
+ * Throughput counters of one source. Each source owns a cache line so that
+ * threads working on different sources never share one.
+ */
+typedef struct alignas (64)
+{
+  std::atomic<uint64_t> frames;
+  /** frames extrapolated instead of analysed, see the source interval */
+  std::atomic<uint64_t> frames_interpolated;
+  std::atomic<uint64_t> objects_examined;
+  std::atomic<uint64_t> objects_counted;
+  /** zone entries */
+  std::atomic<uint64_t> events;
+  /** arrival time of the last frame */
+  std::atomic<uint64_t> last_frame_ns;
+  /** rate from the last frame interval */
+  std::atomic<double> fps;
+  /** exponentially smoothed rate */
+  std::atomic<double> ewma_fps;
+} SourceCounters;
+
+/** point in time view of SourceCounters */
+typedef struct
+{
+  uint64_t frames;
+  uint64_t frames_interpolated;
+  uint64_t objects_examined;
+  uint64_t objects_counted;
+  uint64_t events;
+  double fps;
+  double ewma_fps;
+} SourceCountersSummary;
+
+/**
+ * Count a frame of the source arriving at @now_ns and update its rates. The
+ * smoothing weight follows the frame interval so that irregular sources
+ * decay at the same speed as regular ones.
+ */
+static inline void
+source_counters_add_frame (SourceCounters *counters, uint64_t now_ns)
+{
+  uint64_t last = counters->last_frame_ns.exchange (now_ns,
+      std::memory_order_relaxed);
+
+  counters->frames.fetch_add (1, std::memory_order_relaxed);
+  if (!last || now_ns <= last)
+    return;
+
+  double dt = (now_ns - last) * 1e-9;
+  double fps = 1.0 / dt;
+  double ewma = counters->ewma_fps.load (std::memory_order_relaxed);
+  double alpha = 1.0 - std::exp (-dt / SOURCE_FPS_EWMA_TAU);
+
+  counters->fps.store (fps, std::memory_order_relaxed);
+  counters->ewma_fps.store (ewma ? ewma + alpha * (fps - ewma) : fps,
+      std::memory_order_relaxed);
+}
+
+/** Zero the counters. */
+void source_counters_reset (SourceCounters *counters);
+
+/**
+ * Read the counters at @now_ns. A source that stopped sending sees its
+ * rates drop with the time since its last frame.
+ */
+void source_counters_summarize (const SourceCounters *counters,
+    uint64_t now_ns, SourceCountersSummary *summary);
+
+/** Empty the histogram. Samples recorded concurrently may survive. */
+void latency_histogram_reset (LatencyHistogram *hist);
+
+/**
+ * Summarize the histogram. Percentiles are the midpoint of the bucket they
+ * fall into.
+ */
+void latency_histogram_summarize (const LatencyHistogram *hist,
+    LatencyHistogramSummary *summary);
+
+#endif /* __NVDSPOSTPROCESS_STATS_H__ */
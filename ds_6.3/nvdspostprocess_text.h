@@ -0,0 +1,92 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __NVDSPOSTPROCESS_TEXT_H__
+#define __NVDSPOSTPROCESS_TEXT_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "nvdspostprocess_overlay.h"
+
+/**
+ * Bitmap font text for the overlay. The built-in 6x8 font is scaled and
+ * rasterized once into a glyph atlas, labels compose their glyph run into a
+ * coverage mask only when their string changes and every frame just blends
+ * that mask into the surface.
+ */
+
+/** printable ASCII range covered by the atlas */
+#define TEXT_FIRST_GLYPH 32
+#define TEXT_LAST_GLYPH 126
+#define TEXT_NUM_GLYPHS (TEXT_LAST_GLYPH - TEXT_FIRST_GLYPH + 1)
+
+/** size of a glyph cell of the built-in font, spacing included */
+#define TEXT_CELL_WIDTH 6
+#define TEXT_CELL_HEIGHT 8
+
+/** glyph coverage bitmaps at the selected scale */
+typedef struct
+{
+  uint32_t scale;
+  uint32_t glyph_width;
+  uint32_t glyph_height;
+  /** TEXT_NUM_GLYPHS glyphs of glyph_width * glyph_height bytes */
+  std::vector<uint8_t> atlas;
+} TextAtlas;
+
+/** cached glyph run of a label */
+typedef struct
+{
+  /** string the mask was composed for */
+  std::string text;
+  uint32_t width;
+  uint32_t height;
+  /** width * height coverage mask */
+  std::vector<uint8_t> mask;
+} TextLabel;
+
+/**
+ * Rasterize the built-in font into the atlas.
+ *
+ * @param scale integer magnification of the 6x8 font
+ */
+void text_atlas_init (TextAtlas *atlas, uint32_t scale);
+
+/**
+ * Update the label string, the glyph run is composed again only when the
+ * string differs from the cached one.
+ *
+ * @return true if the mask was re-rendered
+ */
+bool text_label_set (TextLabel *label, const TextAtlas *atlas,
+    const char *text);
+
+/**
+ * Blend the label with its top left corner at (@x, @y) over a background box
+ * padded by atlas->scale pixels. A transparent @bg skips the box.
+ */
+void text_label_draw (OverlaySurface *surf, const TextLabel *label,
+    const TextAtlas *atlas, int32_t x, int32_t y, OverlayColor fg,
+    OverlayColor bg);
+
+#endif /* __NVDSPOSTPROCESS_TEXT_H__ */
@@ -0,0 +1,249 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include <cmath>
+#include <algorithm>
+#include "nvdspostprocess_tiler.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#define RGBA_BYTES_PER_PIXEL 4
+/** fixed point weight of 1.0 */
+#define TILER_WEIGHT_ONE 256
+
+/* Build the taps mapping src_size samples onto dst_size samples. */
+static void
+tiler_filter_build (TilerFilter *filter, uint32_t src_size, uint32_t dst_size)
+{
+  double scale = (double) src_size / dst_size;
+  std::vector<double> taps;
+
+  filter->src_size = src_size;
+  filter->dst_size = dst_size;
+  filter->max_taps = scale > 1.0 ? (uint32_t) std::ceil (scale) + 1 : 2;
+  filter->start.assign (dst_size, 0);
+  filter->count.assign (dst_size, 0);
+  filter->weights.assign ((size_t) dst_size * filter->max_taps, 0);
+
+  for (uint32_t d = 0; d < dst_size; d++) {
+    int32_t first;
+
+    taps.clear ();
+    if (scale > 1.0) {
+      /* Area: weight each source sample by how much of it the destination
+       * sample covers. */
+      double s0 = d * scale;
+      double s1 = std::min ((d + 1) * scale, (double) src_size);
+      first = (int32_t) s0;
+      int32_t last = std::min ((int32_t) std::ceil (s1), (int32_t) src_size);
+      for (int32_t i = first; i < last; i++)
+        taps.push_back ((std::min (i + 1.0, s1) - std::max ((double) i, s0)) /
+            scale);
+    } else {
+      /* Bilinear between the two nearest source samples. */
+      double center = std::max ((d + 0.5) * scale - 0.5, 0.0);
+      first = std::min ((int32_t) center, (int32_t) src_size - 1);
+      double frac = center - first;
+      taps.push_back (1.0 - frac);
+      if (first + 1 < (int32_t) src_size && frac > 0.0)
+        taps.push_back (frac);
+    }
+
+    /* Quantize, the rounding error goes to the heaviest tap so that the
+     * weights always sum to exactly one. */
+    uint16_t *w = &filter->weights[(size_t) d * filter->max_taps];
+    int32_t n = std::min ((int32_t) taps.size (), (int32_t) filter->max_taps);
+    int32_t sum = 0, heaviest = 0;
+    for (int32_t k = 0; k < n; k++) {
+      w[k] = (uint16_t) std::lround (taps[k] * TILER_WEIGHT_ONE);
+      sum += w[k];
+      if (w[k] > w[heaviest])
+        heaviest = k;
+    }
+    w[heaviest] = (uint16_t) (w[heaviest] + TILER_WEIGHT_ONE - sum);
+
+    filter->start[d] = first;
+    filter->count[d] = n;
+  }
+}
+
+/* dst[i] = sum_k(w[k] * rows[k][i]) / 256 over @nbytes bytes. */
+static void
+tiler_blend_rows (const uint8_t *const *rows, const uint16_t *w, int32_t ntaps,
+    uint8_t *dst, uint32_t nbytes)
+{
+  uint32_t i = 0;
+
+#if defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i k128 = _mm_set1_epi16 (128);
+  for (; i + 16 <= nbytes; i += 16) {
+    __m128i acc_lo = k128, acc_hi = k128;
+    for (int32_t k = 0; k < ntaps; k++) {
+      __m128i vw = _mm_set1_epi16 ((short) w[k]);
+      __m128i px = _mm_loadu_si128 ((const __m128i *) (rows[k] + i));
+      acc_lo = _mm_add_epi16 (acc_lo,
+          _mm_mullo_epi16 (_mm_unpacklo_epi8 (px, zero), vw));
+      acc_hi = _mm_add_epi16 (acc_hi,
+          _mm_mullo_epi16 (_mm_unpackhi_epi8 (px, zero), vw));
+    }
+    _mm_storeu_si128 ((__m128i *) (dst + i),
+        _mm_packus_epi16 (_mm_srli_epi16 (acc_lo, 8),
+            _mm_srli_epi16 (acc_hi, 8)));
+  }
+#elif defined(__ARM_NEON)
+  for (; i + 16 <= nbytes; i += 16) {
+    uint16x8_t acc_lo = vdupq_n_u16 (0), acc_hi = vdupq_n_u16 (0);
+    for (int32_t k = 0; k < ntaps; k++) {
+      uint8x16_t px = vld1q_u8 (rows[k] + i);
+      acc_lo = vmlaq_n_u16 (acc_lo, vmovl_u8 (vget_low_u8 (px)), w[k]);
+      acc_hi = vmlaq_n_u16 (acc_hi, vmovl_u8 (vget_high_u8 (px)), w[k]);
+    }
+    vst1q_u8 (dst + i, vcombine_u8 (vrshrn_n_u16 (acc_lo, 8),
+            vrshrn_n_u16 (acc_hi, 8)));
+  }
+#endif
+
+  for (; i < nbytes; i++) {
+    uint32_t acc = 128;
+    for (int32_t k = 0; k < ntaps; k++)
+      acc += w[k] * rows[k][i];
+    dst[i] = (uint8_t) (acc >> 8);
+  }
+}
+
+/* Horizontal pass of one row, all four channels of a pixel at once. */
+static void
+tiler_scale_row (const TilerFilter *filter, const uint8_t *src, uint8_t *dst)
+{
+  for (uint32_t d = 0; d < filter->dst_size; d++) {
+    const uint16_t *w = &filter->weights[(size_t) d * filter->max_taps];
+    const uint8_t *s = src + (size_t) filter->start[d] * RGBA_BYTES_PER_PIXEL;
+    int32_t ntaps = filter->count[d];
+    uint8_t *out = dst + (size_t) d * RGBA_BYTES_PER_PIXEL;
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128 ();
+    __m128i acc = _mm_set1_epi16 (128);
+    for (int32_t k = 0; k < ntaps; k++) {
+      uint32_t px;
+      memcpy (&px, s + k * RGBA_BYTES_PER_PIXEL, sizeof (px));
+      acc = _mm_add_epi16 (acc, _mm_mullo_epi16 (_mm_unpacklo_epi8 (
+                  _mm_cvtsi32_si128 ((int) px), zero),
+              _mm_set1_epi16 ((short) w[k])));
+    }
+    uint32_t res = (uint32_t) _mm_cvtsi128_si32 (
+        _mm_packus_epi16 (_mm_srli_epi16 (acc, 8), zero));
+    memcpy (out, &res, sizeof (res));
+#elif defined(__ARM_NEON)
+    uint16x8_t acc = vdupq_n_u16 (0);
+    for (int32_t k = 0; k < ntaps; k++) {
+      uint32_t px;
+      memcpy (&px, s + k * RGBA_BYTES_PER_PIXEL, sizeof (px));
+      acc = vmlaq_n_u16 (acc, vmovl_u8 (vreinterpret_u8_u32 (vdup_n_u32 (px))),
+          w[k]);
+    }
+    uint32_t res = vget_lane_u32 (vreinterpret_u32_u8 (vrshrn_n_u16 (acc, 8)),
+        0);
+    memcpy (out, &res, sizeof (res));
+#else
+    for (int c = 0; c < RGBA_BYTES_PER_PIXEL; c++) {
+      uint32_t acc = 128;
+      for (int32_t k = 0; k < ntaps; k++)
+        acc += w[k] * s[k * RGBA_BYTES_PER_PIXEL + c];
+      out[c] = (uint8_t) (acc >> 8);
+    }
+#endif
+  }
+}
+
+void
+tiler_scale_rgba (TilerScaler *scaler, const uint8_t *src, uint32_t src_width,
+    uint32_t src_height, uint32_t src_pitch, uint8_t *dst, uint32_t dst_width,
+    uint32_t dst_height, uint32_t dst_pitch)
+{
+  if (!src_width || !src_height || !dst_width || !dst_height)
+    return;
+
+  if (scaler->horiz.src_size != src_width ||
+      scaler->horiz.dst_size != dst_width)
+    tiler_filter_build (&scaler->horiz, src_width, dst_width);
+  if (scaler->vert.src_size != src_height ||
+      scaler->vert.dst_size != dst_height)
+    tiler_filter_build (&scaler->vert, src_height, dst_height);
+  scaler->row.resize ((size_t) src_width * RGBA_BYTES_PER_PIXEL);
+  scaler->rows.resize (scaler->vert.max_taps);
+
+  for (uint32_t y = 0; y < dst_height; y++) {
+    const uint16_t *w =
+        &scaler->vert.weights[(size_t) y * scaler->vert.max_taps];
+    int32_t ntaps = scaler->vert.count[y];
+    const uint8_t **rows = scaler->rows.data ();
+    const uint8_t *row;
+
+    for (int32_t k = 0; k < ntaps; k++)
+      rows[k] = src + (size_t) (scaler->vert.start[y] + k) * src_pitch;
+
+    /* A single full weight tap is the source row itself. */
+    if (ntaps == 1) {
+      row = rows[0];
+    } else {
+      tiler_blend_rows (rows, w, ntaps, scaler->row.data (),
+          src_width * RGBA_BYTES_PER_PIXEL);
+      row = scaler->row.data ();
+    }
+
+    if (src_width == dst_width)
+      memcpy (dst + (size_t) y * dst_pitch, row,
+          (size_t) dst_width * RGBA_BYTES_PER_PIXEL);
+    else
+      tiler_scale_row (&scaler->horiz, row, dst + (size_t) y * dst_pitch);
+  }
+}
+
+void
+tiler_copy_rgba (const uint8_t *src, uint32_t src_pitch, uint8_t *dst,
+    uint32_t dst_pitch, uint32_t width, uint32_t height)
+{
+  for (uint32_t y = 0; y < height; y++)
+    memcpy (dst + (size_t) y * dst_pitch, src + (size_t) y * src_pitch,
+        (size_t) width * RGBA_BYTES_PER_PIXEL);
+}
+
+void
+tiler_clear_rgba (uint8_t *dst, uint32_t dst_pitch, uint32_t width,
+    uint32_t height)
+{
+  const uint8_t pattern[RGBA_BYTES_PER_PIXEL] = { 0, 0, 0, 255 };
+
+  for (uint32_t y = 0; y < height; y++) {
+    uint8_t *row = dst + (size_t) y * dst_pitch;
+    for (uint32_t x = 0; x < width; x++)
+      memcpy (row + (size_t) x * RGBA_BYTES_PER_PIXEL, pattern,
+          sizeof (pattern));
+  }
+}
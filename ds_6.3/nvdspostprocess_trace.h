@@ -0,0 +1,80 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __NVDSPOSTPROCESS_TRACE_H__
+#define __NVDSPOSTPROCESS_TRACE_H__
+
+#include <stdint.h>
+
+/**
+ * Chrome trace / Perfetto JSON writer for hosts without Nsight.
+ * Every recording thread gets its own single producer ring, a writer thread
+ * drains the rings in the background and appends the events to the file, so
+ * recording never blocks on I/O. Events that don't fit in a full ring are
+ * dropped and counted.
+ */
+
+/** sources listed in a trace event */
+#define TRACE_MAX_SOURCES 8
+
+/** span of work, written as a complete ("X") event */
+typedef struct
+{
+  /** static string, the pointer is stored */
+  const char *name;
+  uint64_t start_ns;
+  uint64_t dur_ns;
+  uint64_t batch_num;
+  /** extra args of batch spans, 0 frames omits them */
+  uint32_t num_frames;
+  uint32_t num_objects;
+  uint32_t num_sources;
+  uint16_t sources[TRACE_MAX_SOURCES];
+} TraceEvent;
+
+typedef struct _TraceWriter TraceWriter;
+
+/**
+ * Create the trace file and start the writer thread.
+ *
+ * @param path output file, truncated
+ * @param ring_size events per recording thread, rounded up to a power of two
+ * @return NULL with errno set if the file can't be created
+ */
+TraceWriter *trace_writer_new (const char *path, uint32_t ring_size);
+
+/**
+ * Record an event from the calling thread. Lock free once the thread has
+ * recorded its first event.
+ */
+void trace_writer_record (TraceWriter *writer, const TraceEvent *event);
+
+/** Events dropped because a ring was full. */
+uint64_t trace_writer_dropped (TraceWriter *writer);
+
+/**
+ * Drain the remaining events, terminate the JSON array and close the file.
+ * No thread may be recording anymore.
+ */
+void trace_writer_free (TraceWriter *writer);
+
+#endif /* __NVDSPOSTPROCESS_TRACE_H__ */
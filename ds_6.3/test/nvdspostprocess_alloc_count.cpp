@@ -0,0 +1,115 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include <errno.h>
+#include <stddef.h>
+#include <atomic>
+#include "nvdspostprocess_alloc_count.h"
+
+extern "C" {
+void *__libc_malloc (size_t size);
+void *__libc_calloc (size_t n, size_t size);
+void *__libc_realloc (void *ptr, size_t size);
+void *__libc_memalign (size_t align, size_t size);
+void __libc_free (void *ptr);
+}
+
+/* Initial exec TLS, reading it never allocates. */
+static __thread bool alloc_counting;
+static std::atomic<uint64_t> alloc_total;
+
+static inline void
+alloc_count (void)
+{
+  if (alloc_counting)
+    alloc_total.fetch_add (1, std::memory_order_relaxed);
+}
+
+void
+alloc_count_enable (bool enable)
+{
+  alloc_counting = enable;
+}
+
+uint64_t
+alloc_count_total (void)
+{
+  return alloc_total.load (std::memory_order_relaxed);
+}
+
+/* operator new and the C++ containers go through these as well. */
+extern "C" {
+
+void *
+malloc (size_t size)
+{
+  alloc_count ();
+  return __libc_malloc (size);
+}
+
+void *
+calloc (size_t n, size_t size)
+{
+  alloc_count ();
+  return __libc_calloc (n, size);
+}
+
+void *
+realloc (void *ptr, size_t size)
+{
+  alloc_count ();
+  return __libc_realloc (ptr, size);
+}
+
+void *
+memalign (size_t align, size_t size)
+{
+  alloc_count ();
+  return __libc_memalign (align, size);
+}
+
+void *
+aligned_alloc (size_t align, size_t size)
+{
+  alloc_count ();
+  return __libc_memalign (align, size);
+}
+
+int
+posix_memalign (void **ptr, size_t align, size_t size)
+{
+  alloc_count ();
+  if (align < sizeof (void *) || (align & (align - 1)))
+    return EINVAL;
+  *ptr = __libc_memalign (align, size);
+  return *ptr || !size ? 0 : ENOMEM;
+}
+
+void
+free (void *ptr)
+{
+  __libc_free (ptr);
+}
+
+}
@@ -0,0 +1,402 @@
+/**
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+
+/**
+ * Unit tests of the core library, make test. Only links the core library,
+ * no GStreamer, CUDA or DeepStream.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include <gtest/gtest.h>
+#include "nvdspostprocess_affinity.h"
+#include "nvdspostprocess_analytics.h"
+#include "nvdspostprocess_arena.h"
+#include "nvdspostprocess_heatmap.h"
+#include "nvdspostprocess_overlay.h"
+#include "nvdspostprocess_record.h"
+#include "nvdspostprocess_stats.h"
+#include "nvdspostprocess_tiler.h"
+
+/* Boxes of one frame as parallel arrays. */
+class Frame
+{
+public:
+  void add (float left, float top, float width, float height,
+      uint64_t object_id, bool counted = true)
+  {
+    left_.push_back (left);
+    top_.push_back (top);
+    width_.push_back (width);
+    height_.push_back (height);
+    object_id_.push_back (object_id);
+    counted_.push_back (counted);
+    zone_mask_.push_back (0);
+  }
+
+  AnalyticsObjects objects ()
+  {
+    return {left_.data (), top_.data (), width_.data (), height_.data (),
+        object_id_.data (), counted_.data (), zone_mask_.data ()};
+  }
+
+  size_t size () const { return left_.size (); }
+  uint64_t zone_mask (size_t i) const { return zone_mask_[i]; }
+
+private:
+  std::vector<float> left_, top_, width_, height_;
+  std::vector<uint64_t> object_id_;
+  std::vector<uint8_t> counted_;
+  std::vector<uint64_t> zone_mask_;
+};
+
+static const AnalyticsZone square = {{0, 0}, {100, 0}, {100, 100}, {0, 100}};
+
+TEST (Analytics, PointInZone)
+{
+  AnalyticsZone concave = {{0, 0}, {100, 0}, {100, 100}, {50, 50}, {0, 100}};
+
+  EXPECT_TRUE (analytics_point_in_zone (square, 50, 50));
+  EXPECT_FALSE (analytics_point_in_zone (square, 150, 50));
+  EXPECT_TRUE (analytics_point_in_zone (concave, 50, 25));
+  EXPECT_FALSE (analytics_point_in_zone (concave, 50, 75));
+}
+
+TEST (Analytics, BottomCentreOccupancy)
+{
+  AnalyticsZoneSet zones = {};
+  AnalyticsSource src = {};
+  Frame frame;
+
+  ASSERT_EQ (analytics_zone_set_init (&zones, {square}), 1u);
+  analytics_source_init (&src, &zones);
+  /* Bottom centre (50, 90) inside, (150, 90) and the uncounted one out. */
+  frame.add (40, 70, 20, 20, 1);
+  frame.add (140, 70, 20, 20, 2);
+  frame.add (40, 70, 20, 20, 3, false);
+  AnalyticsObjects objects = frame.objects ();
+
+  EXPECT_EQ (analytics_test_zones (&src, &objects, frame.size ()), 1u);
+  EXPECT_EQ (src.occupancy[0], 1u);
+  EXPECT_EQ (frame.zone_mask (0), 1u);
+  EXPECT_EQ (frame.zone_mask (1), 0u);
+  EXPECT_EQ (frame.zone_mask (2), 0u);
+}
+
+TEST (Analytics, EntriesCountedOncePerTrack)
+{
+  AnalyticsZoneSet zones = {};
+  AnalyticsSource src = {};
+  AnalyticsFrameResult result;
+  uint64_t events = 0;
+
+  analytics_zone_set_init (&zones, {square});
+  analytics_source_init (&src, &zones);
+  /* Track 1 walks into the zone and stays, the bottom centre crosses
+   * y = 100 upwards at the third frame. */
+  for (int f = 0; f < 6; f++) {
+    Frame frame;
+    frame.add (40, 110 - 10 * f, 20, 20, 1);
+    AnalyticsObjects objects = frame.objects ();
+    analytics_process_frame (&src, &objects, frame.size (), &result);
+    events += result.events;
+  }
+  EXPECT_EQ (events, 1u);
+  EXPECT_EQ (src.entries[0], 1u);
+}
+
+TEST (Analytics, SourcesShareZones)
+{
+  AnalyticsZoneSet zones = {};
+  AnalyticsSource a = {}, b = {};
+  AnalyticsFrameResult result;
+
+  analytics_zone_set_init (&zones, {square});
+  analytics_source_init (&a, &zones);
+  analytics_source_init (&b, &zones);
+  /* Only source a sees track 1 walk in, b keeps its own counts. */
+  for (int f = 0; f < 6; f++) {
+    Frame frame;
+    frame.add (40, 110 - 10 * f, 20, 20, 1);
+    AnalyticsObjects objects = frame.objects ();
+    analytics_process_frame (&a, &objects, frame.size (), &result);
+    Frame empty;
+    AnalyticsObjects none = empty.objects ();
+    analytics_process_frame (&b, &none, 0, &result);
+  }
+  EXPECT_EQ (a.entries[0], 1u);
+  EXPECT_EQ (a.occupancy[0], 1u);
+  EXPECT_EQ (b.entries[0], 0u);
+  EXPECT_EQ (b.occupancy[0], 0u);
+}
+
+TEST (Analytics, AnchorModes)
+{
+  AnalyticsZoneSet zones = {};
+  AnalyticsSource src = {};
+  Frame frame;
+
+  /* The box hangs from the bottom edge of the zones: its bottom centre is
+   * outside, its centre and 3/4 of its area are inside. */
+  analytics_zone_set_init (&zones, {square, square, square});
+  analytics_zone_set_anchor (&zones, 1, {ANALYTICS_ANCHOR_CENTROID, 1});
+  analytics_zone_set_anchor (&zones, 2, {ANALYTICS_ANCHOR_OVERLAP, 0.7});
+  analytics_source_init (&src, &zones);
+  frame.add (40, 40, 20, 80, 1);
+  AnalyticsObjects objects = frame.objects ();
+
+  analytics_test_zones (&src, &objects, frame.size ());
+  EXPECT_EQ (frame.zone_mask (0), 0x6u);
+
+  analytics_zone_set_anchor (&zones, 2, {ANALYTICS_ANCHOR_OVERLAP, 0.8});
+  analytics_test_zones (&src, &objects, frame.size ());
+  EXPECT_EQ (frame.zone_mask (0), 0x2u);
+}
+
+TEST (Analytics, ZoneBoxArea)
+{
+  std::vector<AnalyticsPoint> clip[2];
+  AnalyticsZone triangle = {{0, 0}, {100, 0}, {0, 100}};
+
+  EXPECT_DOUBLE_EQ (analytics_zone_box_area (square, 50, 50, 150, 150, clip),
+      2500);
+  EXPECT_DOUBLE_EQ (analytics_zone_box_area (triangle, 0, 0, 50, 50, clip),
+      2500);
+  EXPECT_DOUBLE_EQ (analytics_zone_box_area (square, 200, 0, 300, 10, clip),
+      0);
+}
+
+TEST (Analytics, Coverage)
+{
+  AnalyticsZoneSet zones = {};
+  AnalyticsSource src = {};
+  Frame frame;
+
+  analytics_zone_set_init (&zones, {square});
+  analytics_zone_set_coverage (&zones, 0, true);
+  analytics_source_init (&src, &zones);
+  /* Two overlapping halves count once: the left half and its middle
+   * quarter cover half of the zone. */
+  frame.add (0, 0, 50, 100, 1);
+  frame.add (25, 0, 25, 100, 2);
+  AnalyticsObjects objects = frame.objects ();
+
+  analytics_test_zones (&src, &objects, frame.size ());
+  EXPECT_FLOAT_EQ (src.coverage[0], 0.5f);
+}
+
+TEST (Analytics, ExtrapolatedEntry)
+{
+  AnalyticsZoneSet zones = {};
+  AnalyticsSource src = {};
+  AnalyticsFrameResult result;
+  uint64_t events = 0;
+
+  analytics_zone_set_init (&zones, {square});
+  analytics_source_init (&src, &zones);
+  /* Analysed at y = 130 and 120, then extrapolated 10 pixels per frame
+   * into the zone. */
+  for (int f = 0; f < 2; f++) {
+    Frame frame;
+    frame.add (40, 110 - 10 * f, 20, 20, 1);
+    AnalyticsObjects objects = frame.objects ();
+    analytics_process_frame (&src, &objects, frame.size (), &result);
+  }
+  const AnalyticsTrack *track = analytics_track_find (&src.tracks, 1);
+  ASSERT_NE (track, nullptr);
+  EXPECT_EQ (track->zone_mask, 0u);
+  for (int f = 0; f < 3; f++)
+    events += analytics_extrapolate_frame (&src);
+  EXPECT_EQ (events, 1u);
+  /* What keeps the object of an interpolated frame with remove_uncounted. */
+  EXPECT_EQ (analytics_track_find (&src.tracks, 1)->zone_mask, 1u);
+}
+
+TEST (Analytics, TrackSweep)
+{
+  AnalyticsTrackTable table = {};
+
+  for (uint64_t id = 0; id < 100; id++)
+    analytics_track_lookup (&table, id)->last_frame = id;
+  EXPECT_EQ (table.count, 100u);
+  analytics_track_sweep (&table, 50);
+  EXPECT_EQ (table.count, 50u);
+  EXPECT_EQ (analytics_track_find (&table, 25), nullptr);
+  EXPECT_EQ (analytics_track_find (&table, ANALYTICS_UNTRACKED_ID), nullptr);
+  EXPECT_EQ (table.count, 50u);
+  EXPECT_EQ (analytics_track_lookup (&table, 75)->last_frame, 75u);
+}
+
+TEST (Arena, AlignmentAndOverflow)
+{
+  ScratchArena arena = {};
+
+  ASSERT_TRUE (arena_init (&arena, ARENA_MIN_SIZE));
+  void *a = arena_alloc (&arena, 3, 1);
+  void *b = arena_alloc (&arena, 8, 64);
+  EXPECT_EQ ((uintptr_t) b % 64, 0u);
+  EXPECT_NE (a, b);
+
+  /* Past the block, the allocation still succeeds and the next batch gets
+   * a block as large as this one used. */
+  void *big = arena_alloc (&arena, 4 * ARENA_MIN_SIZE, 8);
+  memset (big, 0, 4 * ARENA_MIN_SIZE);
+  size_t used = arena_reset (&arena);
+  EXPECT_GE (used, 4u * ARENA_MIN_SIZE);
+  EXPECT_GE (arena.size, used);
+  arena_free (&arena);
+}
+
+TEST (Stats, HistogramSummary)
+{
+  static LatencyHistogram hist;
+  LatencyHistogramSummary summary;
+
+  latency_histogram_reset (&hist);
+  for (uint64_t ns = 1; ns <= 1000; ns++)
+    latency_histogram_record (&hist, ns * 1000);
+  latency_histogram_summarize (&hist, &summary);
+
+  EXPECT_EQ (summary.count, 1000u);
+  EXPECT_EQ (summary.max_ns, 1000000u);
+  /* Buckets are 1/8 of a power of 2 wide. */
+  EXPECT_NEAR ((double) summary.p50_ns, 500000, 500000 / 8.0);
+  EXPECT_NEAR ((double) summary.p99_ns, 990000, 990000 / 8.0);
+}
+
+TEST (Affinity, ParseCpus)
+{
+  std::vector<int> cpus;
+
+  ASSERT_TRUE (affinity_parse_cpus ("4-6,0,5", &cpus));
+  EXPECT_EQ (cpus, (std::vector<int> {0, 4, 5, 6}));
+  EXPECT_FALSE (affinity_parse_cpus ("", &cpus));
+  EXPECT_FALSE (affinity_parse_cpus ("3-1", &cpus));
+  EXPECT_FALSE (affinity_parse_cpus ("1,x", &cpus));
+}
+
+TEST (Overlay, FillRectBlendsAndClips)
+{
+  std::vector<uint8_t> frame (8 * 8 * 4, 0);
+  OverlaySurface surf = {};
+
+  overlay_begin_frame (&surf, frame.data (), 8, 8, 8 * 4);
+  overlay_fill_rect (&surf, {6, 6, 20, 20}, {255, 0, 0, 255});
+  EXPECT_EQ (frame[(7 * 8 + 7) * 4], 255);
+  EXPECT_EQ (frame[(5 * 8 + 5) * 4], 0);
+}
+
+TEST (Tiler, ScaleUniformImage)
+{
+  std::vector<uint8_t> src (64 * 48 * 4, 77), dst (16 * 12 * 4, 0);
+  TilerScaler scaler = {};
+
+  tiler_scale_rgba (&scaler, src.data (), 64, 48, 64 * 4, dst.data (), 16, 12,
+      16 * 4);
+  for (uint8_t v : dst)
+    ASSERT_EQ (v, 77);
+}
+
+TEST (Heatmap, FinalSnapshotWritten)
+{
+  char dir[] = "/tmp/nvdspostprocess_test_XXXXXX";
+  ASSERT_NE (mkdtemp (dir), nullptr);
+  Heatmap map = {};
+  Frame frame;
+
+  heatmap_init (&map, 4, 4, 0);
+  frame.add (10, 10, 10, 10, 1);
+  frame.add (70, 70, 10, 10, 2);
+  AnalyticsObjects objects = frame.objects ();
+
+  /* The second snapshot is added while the first may still be written, and
+   * the writer freed without committing it, as at stop. */
+  HeatmapWriter *writer = heatmap_writer_new (dir);
+  ASSERT_NE (writer, nullptr);
+  heatmap_add_frame (&map, &objects, frame.size (), 100, 100);
+  heatmap_writer_add (writer, 5, &map);
+  heatmap_writer_commit (writer);
+  heatmap_add_frame (&map, &objects, frame.size (), 100, 100);
+  heatmap_writer_add (writer, 5, &map);
+  EXPECT_EQ (heatmap_writer_free (writer), 0u);
+
+  std::string path = std::string (dir) + "/source-5.pfm";
+  FILE *file = fopen (path.c_str (), "rb");
+  ASSERT_NE (file, nullptr);
+  unsigned columns, rows;
+  float values[16], sum = 0;
+  ASSERT_EQ (fscanf (file, "Pf\n%u %u\n-1.0", &columns, &rows), 2);
+  ASSERT_EQ (fgetc (file), '\n');
+  ASSERT_EQ (fread (values, sizeof (float), 16, file), 16u);
+  fclose (file);
+  for (float v : values)
+    sum += v;
+  EXPECT_FLOAT_EQ (sum, 4);
+  unlink (path.c_str ());
+  rmdir (dir);
+}
+
+TEST (Record, RoundTrip)
+{
+  char path[] = "/tmp/nvdspostprocess_test_XXXXXX";
+  int fd = mkstemp (path);
+  ASSERT_GE (fd, 0);
+  close (fd);
+
+  RecordBatch batch = {};
+  batch.batch_num = 7;
+  batch.frame_pts = {1000};
+  batch.source_id = {3};
+  batch.frame_num = {42};
+  batch.num_objects = {1};
+  batch.object_id = {9};
+  batch.left = {1};
+  batch.top = {2};
+  batch.width = {3};
+  batch.height = {4};
+  batch.confidence = {0.5};
+  batch.class_id = {2};
+
+  RecordWriter *writer = record_writer_new (path, 1 << 10);
+  ASSERT_NE (writer, nullptr);
+  record_writer_append (writer, &batch);
+  EXPECT_EQ (record_writer_free (writer), 0u);
+
+  RecordReader *reader = record_reader_open (path);
+  RecordBatchView view;
+  ASSERT_NE (reader, nullptr);
+  ASSERT_TRUE (record_reader_next (reader, &view));
+  EXPECT_EQ (view.batch_num, 7u);
+  EXPECT_EQ (view.num_objects, 1u);
+  EXPECT_EQ (view.source_id[0], 3u);
+  EXPECT_EQ (view.object_id[0], 9u);
+  EXPECT_FLOAT_EQ (view.height[0], 4);
+  EXPECT_FALSE (record_reader_next (reader, &view));
+  record_reader_close (reader);
+  unlink (path);
+}